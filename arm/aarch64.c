@@ -0,0 +1,96 @@
+/* AArch64 ID registers read from userspace
+ *
+ * Copyright (c) 2014, 2024 Evgeny Yulyugin.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *   * Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *   * Redistributions in binary form must reproduce the above copyright
+ *     notice, this list of conditions and the following disclaimer in the
+ *     documentation and/or other materials provided with the distribution.
+ *   * The names of its contributors may be used to endorse or promote products
+ *     derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR
+ * ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#define _GNU_SOURCE
+#include <stdint.h>
+#include <sched.h>
+
+#include "aarch64.h"
+#include "hwcap.h"
+#include "sysfs.h"
+
+const char *aa64_registers[AA64_NREGS] = {
+    "Main ID Register",
+    "Revision ID Register",
+    "AArch64 Processor Feature Register 0",
+    "AArch64 Processor Feature Register 1",
+    "SVE Feature ID Register 0",
+    "SME Feature ID Register 0",
+    "AArch64 Instruction Set Attribute Register 0",
+    "AArch64 Instruction Set Attribute Register 1",
+    "AArch64 Instruction Set Attribute Register 2",
+    "AArch64 Memory Model Feature Register 0",
+    "AArch64 Memory Model Feature Register 1",
+    "AArch64 Memory Model Feature Register 2",
+    "Cache Type Register",
+};
+
+#ifdef __aarch64__
+
+/* Generic op0_op1_Cn_Cm_op2 names, so that assemblers that do not know
+ * the newer registers accept them. Kernels that predate a register read it
+ * as zero like any other unallocated ID register. */
+#define read_sysreg(name) ({                                    \
+        uint64_t __val;                                         \
+        __asm__ __volatile__ ("mrs %0, " name : "=r" (__val));  \
+        __val;                                                  \
+    })
+
+int aa64_read_id_regs(uint64_t *regs) {
+    if (!hwcap_has(FEATURE_CPUID))
+        return -1;
+
+    regs[AA64_MIDR] = read_sysreg("S3_0_C0_C0_0");
+    // The kernel reads REVIDR_EL1 as 0 for EL0. The MIDR check catches a
+    // migration to another core type between the two reads.
+    cpu_ident_t id;
+    int cpu = sched_getcpu();
+    regs[AA64_REVIDR] = 0;
+    if (cpu >= 0 && sysfs_read_ident(cpu, &id) == 0 && id.midr == regs[AA64_MIDR])
+        regs[AA64_REVIDR] = id.revidr;
+    regs[AA64_PFR0] = read_sysreg("S3_0_C0_C4_0");
+    regs[AA64_PFR1] = read_sysreg("S3_0_C0_C4_1");
+    regs[AA64_ZFR0] = read_sysreg("S3_0_C0_C4_4");
+    regs[AA64_SMFR0] = read_sysreg("S3_0_C0_C4_5");
+    regs[AA64_ISAR0] = read_sysreg("S3_0_C0_C6_0");
+    regs[AA64_ISAR1] = read_sysreg("S3_0_C0_C6_1");
+    regs[AA64_ISAR2] = read_sysreg("S3_0_C0_C6_2");
+    regs[AA64_MMFR0] = read_sysreg("S3_0_C0_C7_0");
+    regs[AA64_MMFR1] = read_sysreg("S3_0_C0_C7_1");
+    regs[AA64_MMFR2] = read_sysreg("S3_0_C0_C7_2");
+    // CTR_EL0 is readable at EL0 or emulated when SCTLR_EL1.UCT is clear
+    regs[AA64_CTR] = read_sysreg("S3_3_C0_C0_1");
+    return 0;
+}
+
+#else
+
+int aa64_read_id_regs(uint64_t *regs) {
+    (void)regs;
+    return -1;
+}
+
+#endif
@@ -0,0 +1,59 @@
+/* AArch64 ID registers read from userspace
+ *
+ * Copyright (c) 2014, 2024 Evgeny Yulyugin.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *   * Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *   * Redistributions in binary form must reproduce the above copyright
+ *     notice, this list of conditions and the following disclaimer in the
+ *     documentation and/or other materials provided with the distribution.
+ *   * The names of its contributors may be used to endorse or promote products
+ *     derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR
+ * ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifndef GGG_AARCH64_H
+#define GGG_AARCH64_H
+
+#include <stdint.h>
+
+enum {
+    AA64_MIDR,
+    AA64_REVIDR,
+    AA64_PFR0,
+    AA64_PFR1,
+    AA64_ZFR0,
+    AA64_SMFR0,
+    AA64_ISAR0,
+    AA64_ISAR1,
+    AA64_ISAR2,
+    AA64_MMFR0,
+    AA64_MMFR1,
+    AA64_MMFR2,
+    AA64_CTR,
+    AA64_NREGS
+};
+
+extern const char *aa64_registers[AA64_NREGS];
+
+/* Read all ID registers with MRS. EL0 reads trap into the kernel, which
+ * returns the sanitized system-wide values and MIDR of the current CPU.
+ * REVIDR is implementation defined and always emulated as 0, so it is
+ * taken from sysfs for the current CPU instead, and left 0 when sysfs
+ * does not have it. Returns -1 if the kernel does not emulate the
+ * registers or this is not an AArch64 build. */
+int aa64_read_id_regs(uint64_t *regs);
+
+#endif /* GGG_AARCH64_H */
@@ -0,0 +1,174 @@
+/* LSE and LL/SC atomic primitives of ARM
+ *
+ * Copyright (c) 2014, 2024 Evgeny Yulyugin.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *   * Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *   * Redistributions in binary form must reproduce the above copyright
+ *     notice, this list of conditions and the following disclaimer in the
+ *     documentation and/or other materials provided with the distribution.
+ *   * The names of its contributors may be used to endorse or promote products
+ *     derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR
+ * ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/* Every LL/SC update is a load-exclusive, store-exclusive loop that retries
+ * whenever another core touched the line in between, so under contention
+ * on many cores most attempts fail. LSE instructions perform the update at
+ * the cache or interconnect in one go. GCC 10 and later may call similar
+ * out-of-line helpers for __atomic builtins (-moutline-atomics); these
+ * make the choice explicit and visible. */
+
+#include <stdint.h>
+#include <stdio.h>
+
+#include "atomics.h"
+#include "aarch64.h"
+#include "hwcap.h"
+
+#ifdef __aarch64__
+
+static uint64_t lse_fetch_add(uint64_t *p, uint64_t v) {
+    uint64_t old;
+
+    __asm__ __volatile__ (".arch_extension lse\n\t"
+                          "ldaddal %2, %0, %1"
+                          : "=r" (old), "+Q" (*p) : "r" (v) : "memory");
+    return old;
+}
+
+static uint64_t lse_swap(uint64_t *p, uint64_t v) {
+    uint64_t old;
+
+    __asm__ __volatile__ (".arch_extension lse\n\t"
+                          "swpal %2, %0, %1"
+                          : "=r" (old), "+Q" (*p) : "r" (v) : "memory");
+    return old;
+}
+
+static int lse_compare_swap(uint64_t *p, uint64_t *expected, uint64_t desired) {
+    uint64_t old = *expected;
+
+    __asm__ __volatile__ (".arch_extension lse\n\t"
+                          "casal %0, %2, %1"
+                          : "+r" (old), "+Q" (*p) : "r" (desired) : "memory");
+    if (old == *expected)
+        return 1;
+    *expected = old;
+    return 0;
+}
+
+static uint64_t llsc_fetch_add(uint64_t *p, uint64_t v) {
+    uint64_t old, sum;
+    uint32_t failed;
+
+    __asm__ __volatile__ ("1: ldaxr %0, %3\n\t"
+                          "add %1, %0, %4\n\t"
+                          "stlxr %w2, %1, %3\n\t"
+                          "cbnz %w2, 1b"
+                          : "=&r" (old), "=&r" (sum), "=&r" (failed), "+Q" (*p)
+                          : "r" (v) : "memory");
+    return old;
+}
+
+static uint64_t llsc_swap(uint64_t *p, uint64_t v) {
+    uint64_t old;
+    uint32_t failed;
+
+    __asm__ __volatile__ ("1: ldaxr %0, %2\n\t"
+                          "stlxr %w1, %3, %2\n\t"
+                          "cbnz %w1, 1b"
+                          : "=&r" (old), "=&r" (failed), "+Q" (*p)
+                          : "r" (v) : "memory");
+    return old;
+}
+
+static int llsc_compare_swap(uint64_t *p, uint64_t *expected, uint64_t desired) {
+    uint64_t old;
+    uint32_t failed;
+
+    __asm__ __volatile__ ("1: ldaxr %0, %2\n\t"
+                          "cmp %0, %3\n\t"
+                          "b.ne 2f\n\t"
+                          "stlxr %w1, %4, %2\n\t"
+                          "cbnz %w1, 1b\n"
+                          "2:"
+                          : "=&r" (old), "=&r" (failed), "+Q" (*p)
+                          : "r" (*expected), "r" (desired) : "cc", "memory");
+    if (old == *expected)
+        return 1;
+    *expected = old;
+    return 0;
+}
+
+static const atomics_t lse_atomics = {
+    "LSE", lse_fetch_add, lse_swap, lse_compare_swap,
+};
+
+static const atomics_t llsc_atomics = {
+    "LL/SC", llsc_fetch_add, llsc_swap, llsc_compare_swap,
+};
+
+int atomics_level(void) {
+    uint64_t regs[AA64_NREGS];
+
+    if (aa64_read_id_regs(regs) == 0)
+        return (regs[AA64_ISAR0] >> 20) & 0xf;
+    return hwcap_has(FEATURE_ATOMICS) ? ATOMICS_LSE : ATOMICS_LLSC;
+}
+
+static void __attribute__((constructor)) atomics_init(void) {
+    // HWCAP_ATOMICS also covers kernels that hide LSE from user space
+    atomics = hwcap_has(FEATURE_ATOMICS) ? &lse_atomics : &llsc_atomics;
+}
+
+#else
+
+static uint64_t builtin_fetch_add(uint64_t *p, uint64_t v) {
+    return __atomic_fetch_add(p, v, __ATOMIC_SEQ_CST);
+}
+
+static uint64_t builtin_swap(uint64_t *p, uint64_t v) {
+    return __atomic_exchange_n(p, v, __ATOMIC_SEQ_CST);
+}
+
+static int builtin_compare_swap(uint64_t *p, uint64_t *expected, uint64_t desired) {
+    return __atomic_compare_exchange_n(p, expected, desired, 0, __ATOMIC_SEQ_CST,
+                                       __ATOMIC_SEQ_CST);
+}
+
+static const atomics_t builtin_atomics = {
+    "compiler builtins", builtin_fetch_add, builtin_swap, builtin_compare_swap,
+};
+
+int atomics_level(void) {
+    return ATOMICS_LLSC;
+}
+
+static void __attribute__((constructor)) atomics_init(void) {
+    atomics = &builtin_atomics;
+}
+
+#endif
+
+const atomics_t *atomics;
+
+void print_atomics(FILE *f) {
+    static const char *levels[] = {"LL/SC only", "", "LSE", "LSE and LSE128"};
+    int level = atomics_level();
+    const char *desc = level < 4 && *levels[level] ? levels[level] : "unknown";
+
+    fprintf(f, "Atomics: %s, using %s\n", desc, atomics->name);
+}
@@ -0,0 +1,61 @@
+/* LSE and LL/SC atomic primitives of ARM
+ *
+ * Copyright (c) 2014, 2024 Evgeny Yulyugin.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *   * Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *   * Redistributions in binary form must reproduce the above copyright
+ *     notice, this list of conditions and the following disclaimer in the
+ *     documentation and/or other materials provided with the distribution.
+ *   * The names of its contributors may be used to endorse or promote products
+ *     derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR
+ * ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifndef GGG_ATOMICS_H
+#define GGG_ATOMICS_H
+
+#include <stdio.h>
+#include <stdint.h>
+
+/* ID_AA64ISAR0.Atomic */
+enum {
+    ATOMICS_LLSC = 0,       /* load-exclusive/store-exclusive loops only */
+    ATOMICS_LSE = 2,        /* ARMv8.1 CAS, LDADD, SWP */
+    ATOMICS_LSE128 = 3,     /* and their 128-bit forms */
+};
+
+/* Sequentially consistent 64-bit primitives for lock-free queues and
+ * counters, like the __ATOMIC_SEQ_CST builtins */
+typedef struct {
+    const char *name;
+    uint64_t (*fetch_add)(uint64_t *p, uint64_t v);
+    uint64_t (*swap)(uint64_t *p, uint64_t v);
+    /* Stores desired if *p equals *expected; otherwise loads *p into
+     * *expected and returns 0 */
+    int (*compare_swap)(uint64_t *p, uint64_t *expected, uint64_t desired);
+} atomics_t;
+
+/* Implementation selected before main() runs: LSE where the CPU has it,
+ * exclusive loops otherwise, compiler builtins on other architectures */
+extern const atomics_t *atomics;
+
+/* One of ATOMICS_*, from ID_AA64ISAR0 or, without ID register emulation,
+ * HWCAP_ATOMICS */
+int atomics_level(void);
+
+void print_atomics(FILE *f);
+
+#endif /* GGG_ATOMICS_H */
@@ -0,0 +1,230 @@
+/* Cache geometry of ARM CPUs
+ *
+ * Copyright (c) 2014, 2024 Evgeny Yulyugin.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *   * Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *   * Redistributions in binary form must reproduce the above copyright
+ *     notice, this list of conditions and the following disclaimer in the
+ *     documentation and/or other materials provided with the distribution.
+ *   * The names of its contributors may be used to endorse or promote products
+ *     derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR
+ * ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/* CLIDR lists the cache types of every level, CCSIDR selected with CSSELR
+ * gives line size, ways and sets of one of them, CTR the smallest lines
+ * for cache maintenance. User space cannot read CLIDR and CCSIDR, so ARMv7
+ * needs ggg-driver and arm64 has the kernel's cacheinfo in sysfs. */
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "cache.h"
+#include "aarch64.h"
+#include "device.h"
+
+#define SYSFS_CPU "/sys/devices/system/cpu"
+
+int decode_ctr(uint64_t ctr, ctr_info_t *info) {
+    static const char *l1i_policies[] = {
+        "VPIPT", "AIVIVT", "VIPT", "PIPT",
+    };
+
+    // Bit 31 is 1 in the ARMv7 format and RES1 in CTR_EL0
+    if (!(ctr & (1u << 31)))
+        return -1;
+
+    // Line sizes and granules are log2 of the number of 4-byte words
+    info->icache_line = 4u << (ctr & 0xf);
+    info->dcache_line = 4u << ((ctr >> 16) & 0xf);
+    info->erg = (ctr >> 20) & 0xf ? 4u << ((ctr >> 20) & 0xf) : 0;
+    info->cwg = (ctr >> 24) & 0xf ? 4u << ((ctr >> 24) & 0xf) : 0;
+    info->l1i_policy = l1i_policies[(ctr >> 14) & 3];
+    info->idc = (ctr >> 28) & 1;
+    info->dic = (ctr >> 29) & 1;
+    return 0;
+}
+
+int decode_ccsidr(uint32_t clidr, const uint32_t *ccsidr, cache_info_t *caches,
+                  int max) {
+    int n = 0;
+
+    for (int level = 0; level < GGG_NCCSIDR / 2 && n < max; ++level) {
+        uint32_t ctype = (clidr >> (3 * level)) & 7;
+        if (!ctype)
+            break;
+
+        for (int ind = 0; ind < 2 && n < max; ++ind) {
+            uint32_t r = ccsidr[2 * level + ind];
+            if (!r)
+                continue;
+            cache_info_t *c = &caches[n++];
+            c->level = level + 1;
+            c->type = ind ? CACHE_INSTRUCTION
+                          : ctype == 4 ? CACHE_UNIFIED : CACHE_DATA;
+            c->line_size = 16u << (r & 7);
+            c->ways = ((r >> 3) & 0x3ff) + 1;
+            c->sets = ((r >> 13) & 0x7fff) + 1;
+            c->size = c->line_size * c->ways * c->sets;
+        }
+    }
+    return n;
+}
+
+static int read_str(const char *dir, const char *file, char *buf, size_t len) {
+    char path[160];
+
+    snprintf(path, sizeof(path), "%s/%s", dir, file);
+    FILE *f = fopen(path, "r");
+    if (!f)
+        return -1;
+    int ok = fgets(buf, len, f) != NULL;
+    fclose(f);
+    return ok ? 0 : -1;
+}
+
+static uint32_t read_num(const char *dir, const char *file) {
+    char buf[32];
+    return read_str(dir, file, buf, sizeof(buf)) < 0 ? 0 : strtoul(buf, NULL, 10);
+}
+
+/* Attributes firmware does not describe are missing: PPTT and device
+ * trees often give only the size */
+static int sysfs_read_caches(int cpu, cache_info_t *caches, int max) {
+    int n = 0;
+
+    for (int index = 0; n < max; ++index) {
+        char dir[96], buf[32], *end;
+        snprintf(dir, sizeof(dir), SYSFS_CPU "/cpu%d/cache/index%d", cpu, index);
+        if (read_str(dir, "type", buf, sizeof(buf)) < 0)
+            break;
+
+        cache_info_t *c = &caches[n++];
+        c->type = !strncmp(buf, "Data", 4) ? CACHE_DATA
+                  : !strncmp(buf, "Instruction", 11) ? CACHE_INSTRUCTION
+                  : CACHE_UNIFIED;
+        c->level = read_num(dir, "level");
+        c->line_size = read_num(dir, "coherency_line_size");
+        c->ways = read_num(dir, "ways_of_associativity");
+        c->sets = read_num(dir, "number_of_sets");
+        c->size = c->line_size * c->ways * c->sets;
+        if (!c->size && read_str(dir, "size", buf, sizeof(buf)) == 0) {
+            c->size = strtoul(buf, &end, 10);
+            c->size <<= *end == 'K' ? 10 : *end == 'M' ? 20 : 0;
+        }
+    }
+    return n;
+}
+
+int caches_read(cpu_caches_t **cpus) {
+    uint64_t aa64[AA64_NREGS];
+    uint64_t ctr = aa64_read_id_regs(aa64) == 0 ? aa64[AA64_CTR] : 0;
+    uint32_t *regs;
+    int n, count = 0;
+
+    if ((regs = device_map_regs(&n)) == NULL)
+        n = sysconf(_SC_NPROCESSORS_CONF);
+    if (n <= 0 || !(*cpus = calloc(n, sizeof(cpu_caches_t)))) {
+        free(regs);
+        return -1;
+    }
+
+    for (int i = 0; i < n; ++i) {
+        cpu_caches_t *c = &(*cpus)[count];
+        const uint32_t *r = regs ? regs + i * GGG_NREGS : NULL;
+
+        c->cpu = i;
+        c->ctr = ctr;
+        // Drivers before CLIDR capture leave it zero
+        if (r && r[GGG_CLIDR]) {
+            c->ctr = r[GGG_CTR];
+            c->ncaches = decode_ccsidr(r[GGG_CLIDR], r + GGG_CCSIDR,
+                                       c->caches, CACHE_MAX);
+        } else {
+            c->ncaches = sysfs_read_caches(i, c->caches, CACHE_MAX);
+        }
+        // Offline or never online since the driver was loaded
+        if (c->ncaches || (r && r[GGG_MIDR]))
+            count++;
+    }
+    free(regs);
+    if (!count) {
+        free(*cpus);
+        return -1;
+    }
+    return count;
+}
+
+static int same_caches(const cpu_caches_t *a, const cpu_caches_t *b) {
+    return a->ctr == b->ctr && a->ncaches == b->ncaches
+           && !memcmp(a->caches, b->caches, a->ncaches * sizeof(cache_info_t));
+}
+
+static void print_size(FILE *f, uint32_t bytes) {
+    if (bytes >= 1u << 20 && !(bytes & ((1u << 20) - 1)))
+        fprintf(f, "%6u MiB", bytes >> 20);
+    else
+        fprintf(f, "%6u KiB", bytes >> 10);
+}
+
+void print_caches(FILE *f, const cpu_caches_t *cpus, int n) {
+    static const char *types[] = {"", "Data", "Instruction", "Unified"};
+
+    for (int i = 0; i < n; ) {
+        int j = i;
+        while (j + 1 < n && cpus[j + 1].cpu == cpus[j].cpu + 1
+               && same_caches(&cpus[i], &cpus[j + 1]))
+            j++;
+        const cpu_caches_t *c = &cpus[i];
+
+        if (j > i)
+            fprintf(f, "%sCPU %d-%d:\n", i ? "\n" : "", c->cpu, cpus[j].cpu);
+        else
+            fprintf(f, "%sCPU %d:\n", i ? "\n" : "", c->cpu);
+
+        ctr_info_t ctr;
+        if (c->ctr && decode_ctr(c->ctr, &ctr) == 0) {
+            fprintf(f, "Smallest lines: I-cache %u, D-cache %u bytes, L1I %s\n",
+                    ctr.icache_line, ctr.dcache_line, ctr.l1i_policy);
+            if (ctr.erg)
+                fprintf(f, "Exclusives reservation granule: %u bytes\n", ctr.erg);
+            if (ctr.cwg)
+                fprintf(f, "Cache writeback granule: %u bytes\n", ctr.cwg);
+            if (ctr.idc || ctr.dic)
+                fprintf(f, "Coherent for instructions:%s%s\n",
+                        ctr.idc ? " no D-cache clean" : "",
+                        ctr.dic ? " no I-cache invalidation" : "");
+        }
+
+        // Addresses a way size apart map to the same set: strides of
+        // blocked loops should not be multiples of it
+        fprintf(f, "Level  Type               Size  Line  Ways    Sets    Way size\n");
+        for (int k = 0; k < c->ncaches; ++k) {
+            const cache_info_t *ci = &c->caches[k];
+            fprintf(f, "L%-4u  %-11s  ", ci->level, types[ci->type]);
+            print_size(f, ci->size);
+            if (ci->sets) {
+                fprintf(f, "  %4u  %4u  %6u  ", ci->line_size, ci->ways, ci->sets);
+                print_size(f, ci->line_size * ci->sets);
+            }
+            fprintf(f, "\n");
+        }
+        i = j + 1;
+    }
+}
@@ -0,0 +1,86 @@
+/* Cache geometry of ARM CPUs
+ *
+ * Copyright (c) 2014, 2024 Evgeny Yulyugin.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *   * Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *   * Redistributions in binary form must reproduce the above copyright
+ *     notice, this list of conditions and the following disclaimer in the
+ *     documentation and/or other materials provided with the distribution.
+ *   * The names of its contributors may be used to endorse or promote products
+ *     derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR
+ * ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifndef GGG_CACHE_H
+#define GGG_CACHE_H
+
+#include <stdio.h>
+#include <stdint.h>
+
+enum {
+    CACHE_DATA = 1,
+    CACHE_INSTRUCTION = 2,
+    CACHE_UNIFIED = 3,
+};
+
+typedef struct {
+    uint32_t level;
+    uint32_t type;
+    uint32_t size;          /* bytes */
+    uint32_t ways;
+    uint32_t line_size;
+    uint32_t sets;
+} cache_info_t;
+
+/* Cache Type Register fields, sizes in bytes */
+typedef struct {
+    uint32_t icache_line;   /* smallest I-cache line */
+    uint32_t dcache_line;   /* smallest D-cache or unified line */
+    uint32_t erg;           /* exclusives reservation granule, 0 if unknown */
+    uint32_t cwg;           /* cache writeback granule, 0 if unknown */
+    const char *l1i_policy;
+    int idc;                /* D-cache clean not needed for coherence */
+    int dic;                /* I-cache invalidation not needed */
+} ctr_info_t;
+
+#define CACHE_MAX 14
+
+typedef struct {
+    int cpu;
+    uint64_t ctr;           /* 0 if unknown */
+    int ncaches;
+    cache_info_t caches[CACHE_MAX];
+} cpu_caches_t;
+
+/* Decode CTR of the ARMv7 or ARMv8 format. Returns -1 for the ARMv6
+ * format, which has no line sizes of the whole hierarchy. */
+int decode_ctr(uint64_t ctr, ctr_info_t *info);
+
+/* Caches described by CLIDR and the CCSIDR of every level in the layout
+ * of ggg-driver.h. Returns the number of caches stored. */
+int decode_ccsidr(uint32_t clidr, const uint32_t *ccsidr, cache_info_t *caches,
+                  int max);
+
+/* Caches of every online CPU: decoded from the registers captured by the
+ * driver, or read from sysfs cacheinfo, which is how arm64 kernels
+ * publish CLIDR and CCSIDR. Returns the number of CPUs stored in a
+ * malloc'ed array, -1 if neither source is available. */
+int caches_read(cpu_caches_t **cpus);
+
+/* Print the caches, CPUs with equal caches in a row sharing one table */
+void print_caches(FILE *f, const cpu_caches_t *cpus, int n);
+
+#endif /* GGG_CACHE_H */
@@ -0,0 +1,86 @@
+/* Access to the registers captured by ggg-driver
+ *
+ * Copyright (c) 2014, 2024 Evgeny Yulyugin.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *   * Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *   * Redistributions in binary form must reproduce the above copyright
+ *     notice, this list of conditions and the following disclaimer in the
+ *     documentation and/or other materials provided with the distribution.
+ *   * The names of its contributors may be used to endorse or promote products
+ *     derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR
+ * ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <sys/mman.h>
+
+#include "device.h"
+
+/* Copy the registers out of the mapping, retrying while the driver updates
+ * them. A newer driver may capture more registers per CPU than we know. */
+static uint32_t *copy_regs(const struct ggg_page_header *hdr) {
+    const uint32_t *src = (const uint32_t *)((const char *)hdr + GGG_REGS_OFFSET);
+    uint32_t *id = (uint32_t *)calloc(hdr->ncpus, GGG_CPU_SIZE);
+    uint32_t version, n = hdr->nregs < GGG_NREGS ? hdr->nregs : GGG_NREGS;
+
+    if (!id)
+        return NULL;
+    do {
+        while ((version = __atomic_load_n(&hdr->version, __ATOMIC_ACQUIRE)) & 1)
+            ;
+        for (uint32_t cpu = 0; cpu < hdr->ncpus; ++cpu)
+            memcpy(id + cpu * GGG_NREGS, src + cpu * hdr->nregs, n * 4);
+        __atomic_thread_fence(__ATOMIC_ACQUIRE);
+    } while (__atomic_load_n(&hdr->version, __ATOMIC_RELAXED) != version);
+    return id;
+}
+
+uint32_t *device_map_regs(int *ncpus) {
+    int fd = open("/dev/ggg-cpuid", O_RDONLY);
+    if (fd < 0)
+        return NULL;
+
+    long pagesize = sysconf(_SC_PAGESIZE);
+    struct ggg_page_header *hdr = mmap(NULL, pagesize, PROT_READ, MAP_SHARED, fd, 0);
+    if (hdr == MAP_FAILED) {
+        close(fd);
+        return NULL;
+    }
+    if (hdr->magic != GGG_MAGIC) {
+        munmap(hdr, pagesize);
+        close(fd);
+        return NULL;
+    }
+
+    size_t len = GGG_REGS_OFFSET + (size_t)hdr->ncpus * hdr->nregs * 4;
+    len = (len + pagesize - 1) / pagesize * pagesize;
+    munmap(hdr, pagesize);
+    hdr = mmap(NULL, len, PROT_READ, MAP_SHARED, fd, 0);
+    close(fd);
+    if (hdr == MAP_FAILED)
+        return NULL;
+
+    uint32_t *id = copy_regs(hdr);
+    if (id)
+        *ncpus = hdr->ncpus;
+    munmap(hdr, len);
+    return id;
+}
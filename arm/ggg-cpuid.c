@@ -25,14 +25,28 @@
  */
 
 #include <stdint.h>
+#include <inttypes.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <unistd.h>
 #include <sys/types.h>
 #include <sys/stat.h>
 #include <fcntl.h>
+#include <getopt.h>
 
-const int cpuids_num = 18;
+#include "aarch64.h"
+#include "atomics.h"
+#include "cache.h"
+#include "device.h"
+#include "ggg-driver.h"
+#include "hwcap.h"
+#include "midr.h"
+#include "sysfs.h"
+#include "timer.h"
+#include "topology.h"
+#include "vector.h"
+
+const int cpuids_num = GGG_NREGS;
 
 const char *registers[] = {"Main ID Register",
                            "Cache Type Register",
@@ -51,15 +65,27 @@ const char *registers[] = {"Main ID Register",
                            "Instruction Set Attributes Register 2",
                            "Instruction Set Attributes Register 3",
                            "Instruction Set Attributes Register 4",
-                           "Instruction Set Attributes Register 5"
+                           "Instruction Set Attributes Register 5",
+                           "Multiprocessor Affinity Register",
+                           "Revision ID Register",
+                           "Cache Level ID Register",
+                           "Cache Size ID Register L1 data",
+                           "Cache Size ID Register L1 instruction",
+                           "Cache Size ID Register L2 data",
+                           "Cache Size ID Register L2 instruction",
+                           "Cache Size ID Register L3 data",
+                           "Cache Size ID Register L3 instruction",
+                           "Cache Size ID Register L4 data",
+                           "Cache Size ID Register L4 instruction",
+                           "Cache Size ID Register L5 data",
+                           "Cache Size ID Register L5 instruction",
+                           "Cache Size ID Register L6 data",
+                           "Cache Size ID Register L6 instruction",
+                           "Cache Size ID Register L7 data",
+                           "Cache Size ID Register L7 instruction",
+                           "Counter-timer Frequency Register"
                            };
 
-// Vendor definition
-#define ARM     'A'  // 0x41
-#define DEC     'D'  // 0x44
-#define TI      'T'  // 0x54
-#define INTEL   'i'  // 0x69
-
 static uint32_t *get_cpuid() {
     int fd = open("/dev/ggg-cpuid", O_RDONLY);
     if (fd < 0) {
@@ -69,6 +95,8 @@ static uint32_t *get_cpuid() {
     uint32_t *id = (uint32_t *)calloc(cpuids_num, sizeof(uint32_t));
     if (read(fd, id, cpuids_num * 4) < 0) {
         perror("read");
+        free(id);
+        close(fd);
         return NULL;
     }
 
@@ -78,23 +106,165 @@ static uint32_t *get_cpuid() {
     return id;
 }
 
+static void print_help() {
+    printf("ggg-cpuid\n\n");
+    printf("USAGE: ggg-cpuid [options]\n\n");
+    printf("Options:\n");
+    printf("\t-h, --help\tPrint usage and exit.\n");
+    printf("\t-f, --features\tPrint features reported by the kernel, no driver needed\n");
+    printf("\t-C, --caches\tPrint cache levels, sizes, lines, ways and sets\n");
+    printf("\t-p, --per-cpu\tPrint identification registers of every CPU\n");
+    printf("\t-t, --topology\tPrint clusters, core types and affinity plans\n");
+    printf("\t-T, --timer\tPrint generic timer frequency and timestamp cost\n");
+    printf("\t-v, --vectors\tPrint SVE and SME versions and vector lengths\n");
+}
+
+/* Registers of every CPU: MIDR and REVIDR from sysfs on AArch64, all of
+ * them from the driver on ARMv7 */
+static int print_per_cpu() {
+    cpu_ident_t *ids;
+    int n = sysfs_read_idents(&ids);
+    int i, j;
+
+    if (n >= 0) {
+        for (i = 0; i < n; ++i) {
+            printf("%sCPU %d:\n", i ? "\n" : "", ids[i].cpu);
+            printf("%-40s %#18" PRIx64 "\n", "Main ID Register", ids[i].midr);
+            printf("%-40s %#18" PRIx64 "\n", "Revision ID Register", ids[i].revidr);
+        }
+        free(ids);
+        return 0;
+    }
+
+    uint32_t *c = device_map_regs(&n);
+    if (!c) {
+        fprintf(stderr, "Per-CPU registers need ggg-driver to be loaded\n");
+        return 1;
+    }
+    int printed = 0;
+    for (i = 0; i < n; ++i) {
+        const uint32_t *r = c + i * GGG_NREGS;
+        // Never online since the driver was loaded
+        if (!r[GGG_MIDR])
+            continue;
+        printf("%sCPU %d:\n", printed++ ? "\n" : "", i);
+        for (j = 0; j < GGG_NREGS; ++j)
+            printf("%-40s %#10x\n", registers[j], r[j]);
+    }
+    free(c);
+    return 0;
+}
+
+static int print_cache_geometry() {
+    cpu_caches_t *cpus;
+    int n = caches_read(&cpus);
+
+    if (n <= 0) {
+        fprintf(stderr, "Cache geometry needs ggg-driver or sysfs cacheinfo\n");
+        return 1;
+    }
+    print_caches(stdout, cpus, n);
+    free(cpus);
+    return 0;
+}
+
+static int print_cpu_topology() {
+    arm_cpu_t *cpus;
+    int n = topology_read(&cpus);
+
+    if (n <= 0) {
+        fprintf(stderr, "CPU topology needs ggg-driver or arm64 sysfs registers\n");
+        return 1;
+    }
+    print_topology(stdout, cpus, n);
+    free(cpus);
+    return 0;
+}
+
+static int print_generic_timer() {
+    timer_info_t info;
+
+    if (timer_init(&info) < 0) {
+        fprintf(stderr, "The generic timer counter is not readable from user space\n");
+        return 1;
+    }
+    print_timer(stdout, &info);
+    return 0;
+}
+
 int main(int argc, char **argv) {
-    uint32_t *c = get_cpuid();
-    uint32_t implementer = c[0] >> 24;
+    static struct option long_opt[] = {
+        {"help", no_argument, NULL, 'h'},
+        {"caches", no_argument, NULL, 'C'},
+        {"features", no_argument, NULL, 'f'},
+        {"per-cpu", no_argument, NULL, 'p'},
+        {"topology", no_argument, NULL, 't'},
+        {"timer", no_argument, NULL, 'T'},
+        {"vectors", no_argument, NULL, 'v'},
+        {NULL, 0, NULL, 0}
+    };
+    int opt;
+    while ((opt = getopt_long(argc, argv, "hCfptTv", long_opt, NULL)) != -1) {
+        switch (opt) {
+            case 'C':
+                return print_cache_geometry();
+            case 'f':
+                print_hwcaps(stdout);
+                print_atomics(stdout);
+                return 0;
+            case 'p':
+                return print_per_cpu();
+            case 't':
+                return print_cpu_topology();
+            case 'T':
+                return print_generic_timer();
+            case 'v': {
+                vector_info_t info;
+                vector_info(&info);
+                print_vectors(stdout, &info);
+                return 0;
+            }
+            case '?':
+                printf("Use -h, --help options to get usage.\n");
+                return 0;
+            case 'h':
+            default:
+                print_help();
+                return 0;
+        }
+    }
+
+    uint64_t c[AA64_NREGS > cpuids_num ? AA64_NREGS : cpuids_num];
+    const char **names = registers;
+    int count = cpuids_num, width = 10;
     int i = 0;
 
-    if (implementer == ARM)
-        printf("Vendor: ARM\n");
-    else if (implementer == DEC)
-        printf("Vendor: DEC\n");
-    else if (implementer == TI)
-        printf("Vendor: Texas Instruments\n");
-    else if (implementer == INTEL)
-        printf("Vendor: Intel\n");
+    if (aa64_read_id_regs(c) == 0) {
+        names = aa64_registers;
+        count = AA64_NREGS;
+        width = 18;
+    } else {
+        uint32_t *id = get_cpuid();
+        if (!id)
+            return 1;
+        for (i = 0; i < cpuids_num; ++i)
+            c[i] = id[i];
+        free(id);
+    }
+
+    const char *vendor = midr_vendor(c[0]);
+    const midr_core_t *core = midr_lookup(c[0]);
+    if (vendor)
+        printf("Vendor: %s\n", vendor);
+    if (core) {
+        printf("Core: %s r%up%u\n", core->name, (uint32_t)(c[0] >> 20) & 0xf,
+               (uint32_t)c[0] & 0xf);
+        if (core->mcpu)
+            printf("Tuning: -mcpu=%s\n", core->mcpu);
+    }
 
-    for (i = 0; i < cpuids_num; ++i)
-        printf("%-40s %#10x\n", registers[i], c[i]);
+    for (i = 0; i < count; ++i)
+        printf("%-40s %#*" PRIx64 "\n", names[i], width, c[i]);
 
-    free(c);
     return 0;
 }
@@ -28,205 +28,362 @@
 #include <linux/module.h>
 #include <linux/init.h>
 #include <linux/fs.h>
+#include <linux/cpu.h>
+#include <linux/cpuhotplug.h>
+#include <linux/smp.h>
+#include <linux/mm.h>
+#include <linux/vmalloc.h>
+#include <linux/spinlock.h>
+#include <linux/version.h>
+#include <linux/miscdevice.h>
+#include <linux/device.h>
 #include <asm/uaccess.h>
 
-MODULE_LICENSE("BSD 2-Clause");
+#include "ggg-driver.h"
+
+MODULE_LICENSE("Dual BSD/GPL");
 MODULE_AUTHOR("Evgeny Yulyugin <yulyugin@gmail.com>");
 MODULE_DESCRIPTION("ggg-cpuid");
 
-static int device_open(struct inode *, struct file *);
-static int device_release(struct inode *, struct file *);
 static ssize_t device_read(struct file *, char *, size_t, loff_t *);
+static int device_mmap(struct file *, struct vm_area_struct *);
+static loff_t device_llseek(struct file *, loff_t, int);
+
+/* ID registers do not change while the system runs, so they are read once
+ * per CPU, at load or when the CPU comes online, and every read is a
+ * single copy_to_user. Cores of big.LITTLE systems differ, so each CPU
+ * reads its own registers. They live in pages that user space can map,
+ * after a header whose version changes with every update. */
+static struct ggg_page_header *page;
+static size_t page_size;
+static u32 (*regs)[GGG_NREGS];
+static enum cpuhp_state hp_state;
+static DEFINE_SPINLOCK(update_lock);
+
+#define read_cp15(crm, op2) ({                                        \
+    u32 __val;                                                        \
+    __asm__ __volatile__ ("mrc p15, 0, %0, c0, " #crm ", " #op2       \
+                          : "=r" (__val));                            \
+    __val;                                                            \
+  })
+
+/* CLIDR and CCSIDR appeared in ARMv7, which is also the first CTR format
+ * with bits 31:29 of 0b100. CSSELR selects the cache CCSIDR describes;
+ * interrupts are off here and its previous value is put back. */
+static void read_caches(u32 *r) {
+  u32 clidr, csselr, ccsidr;
+  int level;
+
+  if ((r[GGG_CTR] >> 29) != 4)
+    return;
+  __asm__ __volatile__ ("mrc p15, 1, %0, c0, c0, 1" : "=r" (clidr));
+  __asm__ __volatile__ ("mrc p15, 2, %0, c0, c0, 0" : "=r" (csselr));
+  r[GGG_CLIDR] = clidr;
+
+  for (level = 0; level < GGG_NCCSIDR / 2; ++level) {
+    u32 ctype = (clidr >> (3 * level)) & 7;
+    int ind;
+
+    if (!ctype)
+      break;
+    // 1: instruction only, 2: data only, 3: separate, 4: unified
+    for (ind = 0; ind < 2; ++ind) {
+      if (ind ? ctype != 1 && ctype != 3 : ctype == 1)
+        continue;
+      __asm__ __volatile__ ("mcr p15, 2, %1, c0, c0, 0\n\t"
+                            "isb\n\t"
+                            "mrc p15, 1, %0, c0, c0, 0"
+                            : "=r" (ccsidr) : "r" (level << 1 | ind));
+      r[GGG_CCSIDR + 2 * level + ind] = ccsidr;
+    }
+  }
+  __asm__ __volatile__ ("mcr p15, 2, %0, c0, c0, 0\n\tisb" : : "r" (csselr));
+}
+
+static void read_regs(u32 *r) {
+  r[GGG_MIDR] = read_cp15(c0, 0);
+  r[GGG_CTR] = read_cp15(c0, 1);
+  r[GGG_TCMTR] = read_cp15(c0, 2);
+  r[GGG_TLBTR] = read_cp15(c0, 3);
+  r[GGG_ID_PFR0] = read_cp15(c1, 0);
+  r[GGG_ID_PFR1] = read_cp15(c1, 1);
+  r[GGG_ID_DFR0] = read_cp15(c1, 2);
+  r[GGG_ID_AFR0] = read_cp15(c1, 3);
+  r[GGG_ID_MMFR0] = read_cp15(c1, 4);
+  r[GGG_ID_MMFR1] = read_cp15(c1, 5);
+  r[GGG_ID_MMFR2] = read_cp15(c1, 6);
+  r[GGG_ID_MMFR3] = read_cp15(c1, 7);
+  r[GGG_ID_ISAR0] = read_cp15(c2, 0);
+  r[GGG_ID_ISAR1] = read_cp15(c2, 1);
+  r[GGG_ID_ISAR2] = read_cp15(c2, 2);
+  r[GGG_ID_ISAR3] = read_cp15(c2, 3);
+  r[GGG_ID_ISAR4] = read_cp15(c2, 4);
+  r[GGG_ID_ISAR5] = read_cp15(c2, 5);
+  r[GGG_MPIDR] = read_cp15(c0, 5);
+  r[GGG_REVIDR] = read_cp15(c0, 6);
+  read_caches(r);
+  // ID_PFR1.GenTimer
+  if ((r[GGG_ID_PFR1] >> 16) & 0xf)
+    __asm__ __volatile__ ("mrc p15, 0, %0, c14, c0, 0" : "=r" (r[GGG_CNTFRQ]));
+}
+
+static void capture_regs(void *unused) {
+  unsigned long flags;
+
+  spin_lock_irqsave(&update_lock, flags);
+  WRITE_ONCE(page->version, page->version + 1);
+  smp_wmb();
+  read_regs(regs[smp_processor_id()]);
+  smp_wmb();
+  WRITE_ONCE(page->version, page->version + 1);
+  spin_unlock_irqrestore(&update_lock, flags);
+}
+
+/* /sys/devices/system/cpu/cpuN/ggg-cpuid/ has one file per register of
+ * that CPU */
+struct ggg_attribute {
+  struct device_attribute attr;
+  int index;
+};
+
+static ssize_t reg_show(struct device *dev, struct device_attribute *attr,
+                        char *buf) {
+  struct ggg_attribute *ga = container_of(attr, struct ggg_attribute, attr);
+
+  return sprintf(buf, "0x%08x\n", READ_ONCE(regs[dev->id][ga->index]));
+}
+
+#define GGG_ATTR(_name, _index)                                           \
+  static struct ggg_attribute ggg_attr_##_name = {                       \
+    .attr = __ATTR(_name, 0444, reg_show, NULL),                          \
+    .index = _index,                                                      \
+  }
+
+GGG_ATTR(midr, GGG_MIDR);
+GGG_ATTR(ctr, GGG_CTR);
+GGG_ATTR(tcmtr, GGG_TCMTR);
+GGG_ATTR(tlbtr, GGG_TLBTR);
+GGG_ATTR(id_pfr0, GGG_ID_PFR0);
+GGG_ATTR(id_pfr1, GGG_ID_PFR1);
+GGG_ATTR(id_dfr0, GGG_ID_DFR0);
+GGG_ATTR(id_afr0, GGG_ID_AFR0);
+GGG_ATTR(id_mmfr0, GGG_ID_MMFR0);
+GGG_ATTR(id_mmfr1, GGG_ID_MMFR1);
+GGG_ATTR(id_mmfr2, GGG_ID_MMFR2);
+GGG_ATTR(id_mmfr3, GGG_ID_MMFR3);
+GGG_ATTR(id_isar0, GGG_ID_ISAR0);
+GGG_ATTR(id_isar1, GGG_ID_ISAR1);
+GGG_ATTR(id_isar2, GGG_ID_ISAR2);
+GGG_ATTR(id_isar3, GGG_ID_ISAR3);
+GGG_ATTR(id_isar4, GGG_ID_ISAR4);
+GGG_ATTR(id_isar5, GGG_ID_ISAR5);
+GGG_ATTR(mpidr, GGG_MPIDR);
+GGG_ATTR(revidr, GGG_REVIDR);
+GGG_ATTR(clidr, GGG_CLIDR);
+GGG_ATTR(ccsidr_l1d, GGG_CCSIDR + 0);
+GGG_ATTR(ccsidr_l1i, GGG_CCSIDR + 1);
+GGG_ATTR(ccsidr_l2d, GGG_CCSIDR + 2);
+GGG_ATTR(ccsidr_l2i, GGG_CCSIDR + 3);
+GGG_ATTR(ccsidr_l3d, GGG_CCSIDR + 4);
+GGG_ATTR(ccsidr_l3i, GGG_CCSIDR + 5);
+GGG_ATTR(ccsidr_l4d, GGG_CCSIDR + 6);
+GGG_ATTR(ccsidr_l4i, GGG_CCSIDR + 7);
+GGG_ATTR(ccsidr_l5d, GGG_CCSIDR + 8);
+GGG_ATTR(ccsidr_l5i, GGG_CCSIDR + 9);
+GGG_ATTR(ccsidr_l6d, GGG_CCSIDR + 10);
+GGG_ATTR(ccsidr_l6i, GGG_CCSIDR + 11);
+GGG_ATTR(ccsidr_l7d, GGG_CCSIDR + 12);
+GGG_ATTR(ccsidr_l7i, GGG_CCSIDR + 13);
+GGG_ATTR(cntfrq, GGG_CNTFRQ);
+
+static struct attribute *ggg_attrs[] = {
+  &ggg_attr_midr.attr.attr,
+  &ggg_attr_ctr.attr.attr,
+  &ggg_attr_tcmtr.attr.attr,
+  &ggg_attr_tlbtr.attr.attr,
+  &ggg_attr_id_pfr0.attr.attr,
+  &ggg_attr_id_pfr1.attr.attr,
+  &ggg_attr_id_dfr0.attr.attr,
+  &ggg_attr_id_afr0.attr.attr,
+  &ggg_attr_id_mmfr0.attr.attr,
+  &ggg_attr_id_mmfr1.attr.attr,
+  &ggg_attr_id_mmfr2.attr.attr,
+  &ggg_attr_id_mmfr3.attr.attr,
+  &ggg_attr_id_isar0.attr.attr,
+  &ggg_attr_id_isar1.attr.attr,
+  &ggg_attr_id_isar2.attr.attr,
+  &ggg_attr_id_isar3.attr.attr,
+  &ggg_attr_id_isar4.attr.attr,
+  &ggg_attr_id_isar5.attr.attr,
+  &ggg_attr_mpidr.attr.attr,
+  &ggg_attr_revidr.attr.attr,
+  &ggg_attr_clidr.attr.attr,
+  &ggg_attr_ccsidr_l1d.attr.attr,
+  &ggg_attr_ccsidr_l1i.attr.attr,
+  &ggg_attr_ccsidr_l2d.attr.attr,
+  &ggg_attr_ccsidr_l2i.attr.attr,
+  &ggg_attr_ccsidr_l3d.attr.attr,
+  &ggg_attr_ccsidr_l3i.attr.attr,
+  &ggg_attr_ccsidr_l4d.attr.attr,
+  &ggg_attr_ccsidr_l4i.attr.attr,
+  &ggg_attr_ccsidr_l5d.attr.attr,
+  &ggg_attr_ccsidr_l5i.attr.attr,
+  &ggg_attr_ccsidr_l6d.attr.attr,
+  &ggg_attr_ccsidr_l6i.attr.attr,
+  &ggg_attr_ccsidr_l7d.attr.attr,
+  &ggg_attr_ccsidr_l7i.attr.attr,
+  &ggg_attr_cntfrq.attr.attr,
+  NULL
+};
+
+static const struct attribute_group ggg_group = {
+  .name = "ggg-cpuid",
+  .attrs = ggg_attrs,
+};
+
+static int add_cpu_group(unsigned int cpu) {
+  struct device *dev = get_cpu_device(cpu);
 
-static int major = 0;
-static atomic_t is_open = ATOMIC_INIT(0);
+  return dev ? sysfs_create_group(&dev->kobj, &ggg_group) : 0;
+}
+
+static int cpu_online_cb(unsigned int cpu) {
+  // Online callbacks of dynamic states run on the CPU being plugged
+  capture_regs(NULL);
+  return add_cpu_group(cpu);
+}
+
+static int cpu_offline_cb(unsigned int cpu) {
+  struct device *dev = get_cpu_device(cpu);
+
+  if (dev)
+    sysfs_remove_group(&dev->kobj, &ggg_group);
+  return 0;
+}
 
 static struct file_operations fops = {
+  .owner = THIS_MODULE,
   .read = device_read,
-  .open = device_open,
-  .release = device_release
+  .llseek = device_llseek,
+  .mmap = device_mmap
+};
+
+/* udev creates /dev/ggg-cpuid for a misc device */
+static struct miscdevice ggg_misc = {
+  .minor = MISC_DYNAMIC_MINOR,
+  .name = "ggg-cpuid",
+  .fops = &fops,
+  .mode = 0444,
 };
 
 static int __init test_init(void) {
-  if ((major = register_chrdev(0, "ggg-cpuid", &fops)) < 0) {
-    printk("Registering the character device failed with %d\n", major);
-    return major;
+  int cpu, ret;
+
+  page_size = PAGE_ALIGN(GGG_REGS_OFFSET + nr_cpu_ids * GGG_CPU_SIZE);
+  page = vmalloc_user(page_size);
+  if (!page)
+    return -ENOMEM;
+  page->magic = GGG_MAGIC;
+  page->ncpus = nr_cpu_ids;
+  page->nregs = GGG_NREGS;
+  regs = (void *)page + GGG_REGS_OFFSET;
+
+  cpus_read_lock();
+  for_each_online_cpu(cpu) {
+    smp_call_function_single(cpu, capture_regs, NULL, 1);
+    add_cpu_group(cpu);
+  }
+  ret = cpuhp_setup_state_nocalls_cpuslocked(CPUHP_AP_ONLINE_DYN,
+                                             "ggg-cpuid:online",
+                                             cpu_online_cb, cpu_offline_cb);
+  if (ret < 0) {
+    for_each_online_cpu(cpu)
+      cpu_offline_cb(cpu);
+  }
+  cpus_read_unlock();
+  if (ret < 0) {
+    vfree(page);
+    return ret;
+  }
+  hp_state = ret;
+
+  if ((ret = misc_register(&ggg_misc)) < 0) {
+    printk("Registering the misc device failed with %d\n", ret);
+    cpuhp_remove_state(hp_state);
+    vfree(page);
+    return ret;
   }
   printk(KERN_ALERT "ggg-cpuid module is loaded\n");
-  printk("Please, create a dev file with 'mknod /dev/ggg-cpuid c %d 0'.\n", major);
   return 0;
 }
 
 static void __exit test_exit(void) {
-  unregister_chrdev(major, "ggg-cpuid");
+  misc_deregister(&ggg_misc);
+  // Runs the offline callback on every online CPU, removing sysfs groups
+  cpuhp_remove_state(hp_state);
+  vfree(page);
   printk(KERN_ALERT "ggg-cpuid module is unloaded!\n");
 }
 
 module_init(test_init);
 module_exit(test_exit);
 
-static int device_open(struct inode *inode, struct file *file) {
-  if (atomic_add_unless(&is_open, 1, 1) == 0)
-    return -EBUSY;
-  return 0;
-}
+/* The version works as a sequence count: writers serialize on update_lock
+ * and make it odd while they store, readers take no lock and copy again if
+ * it changed under them. Any number of processes may have the device open
+ * and read it at the same time. */
+static u32 read_version_begin(void) {
+  u32 version;
 
-static int device_release(struct inode *inode, struct file *file) {
-  atomic_dec(&is_open);
-  return 0;
+  while ((version = READ_ONCE(page->version)) & 1)
+    cpu_relax();
+  smp_rmb();
+  return version;
 }
 
-int put_word(uint32_t cpuid_val, char *buffer) {
-  int count = 4;
-  while (count--) {
-    if (put_user(cpuid_val >> ((3 - count) * 8), buffer))
-      return -EFAULT;
-    buffer++;
-  }
-  return 0;
+static bool read_version_retry(u32 version) {
+  smp_rmb();
+  return READ_ONCE(page->version) != version;
 }
 
+/* The device reads like a file of nr_cpu_ids * GGG_CPU_SIZE bytes: reads
+ * start at the file offset, stop at the end and pread works, so a tool can
+ * fetch only MIDR of CPU 0 with 4 bytes at offset 0 */
 static ssize_t device_read(struct file *filp,
                            char *buffer,
                            size_t length,
                            loff_t *offset) {
-  int count = 0;
-  uint32_t id = 0;
+  loff_t size = (loff_t)nr_cpu_ids * GGG_CPU_SIZE;
+  size_t count;
+  u32 version;
 
-  if (length < 0)
+  if (*offset < 0)
+    return -EINVAL;
+  if (*offset >= size)
     return 0;
+  count = min_t(loff_t, length, size - *offset);
 
-  count = length/4;
-
-  switch (count) {
-    default:
-    case 18:
-      __asm__ __volatile__ (
-        "mrc p15, 0, %0, c0, c2, 5"
-        : "=r" (id)
-      );
-      if (put_word(id, buffer + 17 * 4))
-        return -EFAULT;
-    case 17:
-      __asm__ __volatile__ (
-        "mrc p15, 0, %0, c0, c2, 4"
-        : "=r" (id)
-      );
-      if (put_word(id, buffer + 16 * 4))
-        return -EFAULT;
-    case 16:
-      __asm__ __volatile__ (
-        "mrc p15, 0, %0, c0, c2, 3"
-        : "=r" (id)
-      );
-      if (put_word(id, buffer + 15 * 4))
-        return -EFAULT;
-    case 15:
-      __asm__ __volatile__ (
-        "mrc p15, 0, %0, c0, c2, 2"
-        : "=r" (id)
-      );
-      if (put_word(id, buffer + 14 * 4))
-        return -EFAULT;
-    case 14:
-      __asm__ __volatile__ (
-        "mrc p15, 0, %0, c0, c2, 1"
-        : "=r" (id)
-      );
-      if (put_word(id, buffer + 13 * 4))
-        return -EFAULT;
-    case 13:
-      __asm__ __volatile__ (
-        "mrc p15, 0, %0, c0, c2, 0"
-        : "=r" (id)
-      );
-      if (put_word(id, buffer + 12 * 4))
-        return -EFAULT;
-    case 12:
-      __asm__ __volatile__ (
-        "mrc p15, 0, %0, c0, c1, 7"
-        : "=r" (id)
-      );
-      if (put_word(id, buffer + 11 * 4))
-        return -EFAULT;
-    case 11:
-      __asm__ __volatile__ (
-        "mrc p15, 0, %0, c0, c1, 6"
-        : "=r" (id)
-      );
-      if (put_word(id, buffer + 10 * 4))
-        return -EFAULT;
-    case 10:
-      __asm__ __volatile__ (
-        "mrc p15, 0, %0, c0, c1, 5"
-        : "=r" (id)
-      );
-      if (put_word(id, buffer + 9 * 4))
-        return -EFAULT;
-    case 9:
-      __asm__ __volatile__ (
-        "mrc p15, 0, %0, c0, c1, 4"
-        : "=r" (id)
-      );
-      if (put_word(id, buffer + 8 * 4))
-        return -EFAULT;
-    case 8:
-      __asm__ __volatile__ (
-        "mrc p15, 0, %0, c0, c1, 3"
-        : "=r" (id)
-      );
-      if (put_word(id, buffer + 7 * 4))
-        return -EFAULT;
-    case 7:
-      __asm__ __volatile__ (
-        "mrc p15, 0, %0, c0, c1, 2"
-        : "=r" (id)
-      );
-      if (put_word(id, buffer + 6 * 4))
-        return -EFAULT;
-    case 6:
-      __asm__ __volatile__ (
-        "mrc p15, 0, %0, c0, c1, 1"
-        : "=r" (id)
-      );
-      if (put_word(id, buffer + 5 * 4))
-        return -EFAULT;
-    case 5:
-      __asm__ __volatile__ (
-        "mrc p15, 0, %0, c0, c1, 0"
-        : "=r" (id)
-      );
-      if (put_word(id, buffer + 4 * 4))
-        return -EFAULT;
-    case 4:
-      __asm__ __volatile__ (
-        "mrc p15, 0, %0, c0, c0, 3"
-        : "=r" (id)
-      );
-      if (put_word(id, buffer + 3 * 4))
-        return -EFAULT;
-    case 3:
-      __asm__ __volatile__ (
-        "mrc p15, 0, %0, c0, c0, 2"
-        : "=r" (id)
-      );
-      if (put_word(id, buffer + 2 * 4))
-        return -EFAULT;
-    case 2:
-      __asm__ __volatile__ (
-        "mrc p15, 0, %0, c0, c0, 1"
-        : "=r" (id)
-      );
-      if (put_word(id, buffer + 4))
-        return -EFAULT;
-    case 1:
-      __asm__ __volatile__ (
-        "mrc p15, 0, %0, c0, c0, 0"
-        : "=r" (id)
-      );
-      if (put_word(id, buffer))
-        return -EFAULT;
-    case 0:
-      return count * 4;
-  }
+  do {
+    version = read_version_begin();
+    if (copy_to_user(buffer, (char *)regs + *offset, count))
+      return -EFAULT;
+  } while (read_version_retry(version));
+  *offset += count;
+  return count;
+}
+
+static loff_t device_llseek(struct file *filp, loff_t offset, int whence) {
+  return fixed_size_llseek(filp, offset, whence,
+                           (loff_t)nr_cpu_ids * GGG_CPU_SIZE);
+}
+
+static int device_mmap(struct file *filp, struct vm_area_struct *vma) {
+  if (vma->vm_flags & VM_WRITE)
+    return -EPERM;
+#if LINUX_VERSION_CODE >= KERNEL_VERSION(6, 3, 0)
+  vm_flags_clear(vma, VM_MAYWRITE);
+#else
+  vma->vm_flags &= ~VM_MAYWRITE;
+#endif
+  return remap_vmalloc_range(vma, page, vma->vm_pgoff);
 }
@@ -0,0 +1,84 @@
+/* Interface of ggg-driver shared with user space
+ *
+ * Copyright (c) 2014, 2024 Evgeny Yulyugin.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *   * Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *   * Redistributions in binary form must reproduce the above copyright
+ *     notice, this list of conditions and the following disclaimer in the
+ *     documentation and/or other materials provided with the distribution.
+ *   * The names of its contributors may be used to endorse or promote products
+ *     derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR
+ * ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifndef GGG_DRIVER_H
+#define GGG_DRIVER_H
+
+#include <linux/types.h>
+
+/* CCSIDR of up to 7 cache levels, data or unified and instruction */
+#define GGG_NCCSIDR 14
+
+/* ARMv7 CP15 identification registers in the order the driver returns
+ * them, 32 bits each. CCSIDR of level n is at GGG_CCSIDR + 2 * (n - 1) for
+ * data or unified caches and one after for instruction caches, zero where
+ * CLIDR reports no such cache. CNTFRQ is zero without the generic timer. */
+enum {
+  GGG_MIDR,
+  GGG_CTR,
+  GGG_TCMTR,
+  GGG_TLBTR,
+  GGG_ID_PFR0,
+  GGG_ID_PFR1,
+  GGG_ID_DFR0,
+  GGG_ID_AFR0,
+  GGG_ID_MMFR0,
+  GGG_ID_MMFR1,
+  GGG_ID_MMFR2,
+  GGG_ID_MMFR3,
+  GGG_ID_ISAR0,
+  GGG_ID_ISAR1,
+  GGG_ID_ISAR2,
+  GGG_ID_ISAR3,
+  GGG_ID_ISAR4,
+  GGG_ID_ISAR5,
+  GGG_MPIDR,
+  GGG_REVIDR,
+  GGG_CLIDR,
+  GGG_CCSIDR,
+  GGG_CNTFRQ = GGG_CCSIDR + GGG_NCCSIDR,
+  GGG_NREGS
+};
+
+/* The device holds GGG_NREGS registers of every possible CPU in the order
+ * of CPU numbers. CPUs that have not been online since the driver was
+ * loaded read as zeroes. */
+#define GGG_CPU_SIZE (GGG_NREGS * 4)
+
+/* mmap() of the device gives read-only pages that start with this header,
+ * followed by the registers in the same layout */
+#define GGG_MAGIC 0x44474747    /* "GGGD" */
+
+struct ggg_page_header {
+  __u32 magic;
+  __u32 version;    /* odd while the registers are being updated */
+  __u32 ncpus;
+  __u32 nregs;
+};
+
+#define GGG_REGS_OFFSET sizeof(struct ggg_page_header)
+
+#endif /* GGG_DRIVER_H */
@@ -0,0 +1,126 @@
+/* CPU features of ARM systems from the auxiliary vector
+ *
+ * Copyright (c) 2014, 2024 Evgeny Yulyugin.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *   * Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *   * Redistributions in binary form must reproduce the above copyright
+ *     notice, this list of conditions and the following disclaimer in the
+ *     documentation and/or other materials provided with the distribution.
+ *   * The names of its contributors may be used to endorse or promote products
+ *     derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR
+ * ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/* The kernel reports features it supports and enables for user space in
+ * the HWCAP words of the auxiliary vector, which getauxval() reads from
+ * the process's memory. Unlike the ID registers they account for features
+ * the kernel disabled, and need no driver on ARMv7. Bit numbers are those
+ * of the kernel's uapi asm/hwcap.h, which the C library may predate. */
+
+#include <stdint.h>
+#include <stdio.h>
+
+#include "hwcap.h"
+
+#if defined(__aarch64__) || defined(__arm__)
+#include <sys/auxv.h>
+#endif
+
+#ifndef AT_HWCAP2
+#define AT_HWCAP2 26
+#endif
+
+const char *hwcap_names[FEATURE_COUNT] = {
+    "asimd",
+    "fp16",
+    "dotprod",
+    "aes",
+    "pmull",
+    "sha1",
+    "sha2",
+    "sha3",
+    "sha512",
+    "crc32",
+    "atomics",
+    "cpuid",
+    "sve",
+    "sve2",
+    "sme",
+    "sme2",
+    "bf16",
+    "i8mm",
+};
+
+uint32_t hwcap_features;
+
+#if defined(__aarch64__) || defined(__arm__)
+
+static const struct {
+    int feature;
+    unsigned long type;
+    int bit;
+} hwcap_bits[] = {
+#ifdef __aarch64__
+    {FEATURE_ASIMD, AT_HWCAP, 1},
+    {FEATURE_FP16, AT_HWCAP, 10},
+    {FEATURE_DOTPROD, AT_HWCAP, 20},
+    {FEATURE_AES, AT_HWCAP, 3},
+    {FEATURE_PMULL, AT_HWCAP, 4},
+    {FEATURE_SHA1, AT_HWCAP, 5},
+    {FEATURE_SHA2, AT_HWCAP, 6},
+    {FEATURE_SHA3, AT_HWCAP, 17},
+    {FEATURE_SHA512, AT_HWCAP, 21},
+    {FEATURE_CRC32, AT_HWCAP, 7},
+    {FEATURE_ATOMICS, AT_HWCAP, 8},
+    {FEATURE_CPUID, AT_HWCAP, 11},
+    {FEATURE_SVE, AT_HWCAP, 22},
+    {FEATURE_SVE2, AT_HWCAP2, 1},
+    {FEATURE_SME, AT_HWCAP2, 23},
+    {FEATURE_SME2, AT_HWCAP2, 37},
+    {FEATURE_BF16, AT_HWCAP2, 14},
+    {FEATURE_I8MM, AT_HWCAP2, 13},
+#else
+    // 32-bit kernels report the ARMv8 crypto extensions in AT_HWCAP2
+    {FEATURE_ASIMD, AT_HWCAP, 12},
+    {FEATURE_AES, AT_HWCAP2, 0},
+    {FEATURE_PMULL, AT_HWCAP2, 1},
+    {FEATURE_SHA1, AT_HWCAP2, 2},
+    {FEATURE_SHA2, AT_HWCAP2, 3},
+    {FEATURE_CRC32, AT_HWCAP2, 4},
+#endif
+};
+
+/* Before the constructors of other files, which may dispatch on features */
+static void __attribute__((constructor(101))) hwcap_init(void) {
+    unsigned long hwcap = getauxval(AT_HWCAP), hwcap2 = getauxval(AT_HWCAP2);
+    uint32_t features = 0;
+
+    for (size_t i = 0; i < sizeof(hwcap_bits) / sizeof(hwcap_bits[0]); ++i) {
+        unsigned long word = hwcap_bits[i].type == AT_HWCAP ? hwcap : hwcap2;
+        // Bits above 31 exist only in 64-bit auxiliary vectors
+        if (hwcap_bits[i].bit < (int)sizeof(word) * 8
+            && (word >> hwcap_bits[i].bit) & 1)
+            features |= 1u << hwcap_bits[i].feature;
+    }
+    hwcap_features = features;
+}
+
+#endif
+
+void print_hwcaps(FILE *f) {
+    for (int i = 0; i < FEATURE_COUNT; ++i)
+        fprintf(f, "%-10s %s\n", hwcap_names[i], hwcap_has(i) ? "yes" : "no");
+}
@@ -0,0 +1,70 @@
+/* CPU features of ARM systems from the auxiliary vector
+ *
+ * Copyright (c) 2014, 2024 Evgeny Yulyugin.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *   * Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *   * Redistributions in binary form must reproduce the above copyright
+ *     notice, this list of conditions and the following disclaimer in the
+ *     documentation and/or other materials provided with the distribution.
+ *   * The names of its contributors may be used to endorse or promote products
+ *     derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR
+ * ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifndef GGG_HWCAP_H
+#define GGG_HWCAP_H
+
+#include <stdio.h>
+#include <stdint.h>
+
+enum {
+    FEATURE_ASIMD,      /* NEON */
+    FEATURE_FP16,       /* half-precision Advanced SIMD */
+    FEATURE_DOTPROD,
+    FEATURE_AES,
+    FEATURE_PMULL,
+    FEATURE_SHA1,
+    FEATURE_SHA2,
+    FEATURE_SHA3,
+    FEATURE_SHA512,
+    FEATURE_CRC32,
+    FEATURE_ATOMICS,    /* LSE */
+    FEATURE_CPUID,      /* EL0 reads of ID registers are emulated */
+    FEATURE_SVE,
+    FEATURE_SVE2,
+    FEATURE_SME,
+    FEATURE_SME2,
+    FEATURE_BF16,
+    FEATURE_I8MM,
+    FEATURE_COUNT
+};
+
+extern const char *hwcap_names[FEATURE_COUNT];
+
+/* Bit per feature, filled from AT_HWCAP and AT_HWCAP2 before main() runs.
+ * Zero on other architectures. */
+extern uint32_t hwcap_features;
+
+/* Whether the kernel reports a feature usable by this process. Neither
+ * traps nor system calls, so runtime dispatch can call it anywhere. */
+static inline int hwcap_has(int feature) {
+    return (hwcap_features >> feature) & 1;
+}
+
+/* Print every feature with whether it is present */
+void print_hwcaps(FILE *f);
+
+#endif /* GGG_HWCAP_H */
@@ -0,0 +1,169 @@
+/* Generator of the MIDR perfect hash table
+ *
+ * Copyright (c) 2014, 2024 Evgeny Yulyugin.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *   * Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *   * Redistributions in binary form must reproduce the above copyright
+ *     notice, this list of conditions and the following disclaimer in the
+ *     documentation and/or other materials provided with the distribution.
+ *   * The names of its contributors may be used to endorse or promote products
+ *     derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR
+ * ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/* Builds midr-table.h from midr.def with hash and displace: keys are split
+ * into buckets by one hash, then every bucket, largest first, gets the
+ * first seed that puts all its keys into free slots. A lookup hashes
+ * twice and compares one slot.
+ *
+ *   gcc midr-gen.c -o midr-gen && ./midr-gen > midr-table.h
+ */
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "midr.h"
+
+#define MAX_SEED 0xffff
+
+typedef struct {
+    int implementer, part;
+    const char *name, *mcpu, *rank;
+    uint32_t key;
+} entry_t;
+
+static entry_t entries[] = {
+#define VENDOR(implementer, name)
+#define CORE(implementer, part, name, rank, mcpu) \
+    {implementer, part, #name, #mcpu, #rank, 0},
+#include "midr.def"
+#undef VENDOR
+#undef CORE
+};
+
+#define NENTRIES ((int)(sizeof(entries) / sizeof(entries[0])))
+
+static int nbuckets, table_size;
+static int bucket_of[NENTRIES];
+static uint16_t seeds[NENTRIES];
+static int slot_of[NENTRIES];
+
+static int compute_keys(void) {
+    for (int i = 0; i < NENTRIES; ++i) {
+        entry_t *e = &entries[i];
+        e->key = midr_key((uint32_t)e->implementer << 24 | (uint32_t)e->part << 4);
+        for (int j = 0; j < i; ++j) {
+            if (entries[j].key == e->key) {
+                fprintf(stderr, "%s and %s have the same key\n",
+                        entries[j].name, e->name);
+                return -1;
+            }
+        }
+    }
+    return 0;
+}
+
+/* Seeds of all buckets, or -1 if some bucket fits nowhere */
+static int place(void) {
+    int *order = malloc(nbuckets * sizeof(int)), *size = calloc(nbuckets, sizeof(int));
+    char *used = calloc(table_size, 1);
+    int ok = order && size && used;
+
+    for (int i = 0; i < NENTRIES; ++i) {
+        bucket_of[i] = midr_hash(entries[i].key, 0) % nbuckets;
+        size[bucket_of[i]]++;
+    }
+    for (int b = 0; ok && b < nbuckets; ++b) {
+        int k = b;
+        while (k > 0 && size[order[k - 1]] < size[b]) {
+            order[k] = order[k - 1];
+            k--;
+        }
+        order[k] = b;
+    }
+
+    for (int k = 0; ok && k < nbuckets; ++k) {
+        int b = order[k], seed;
+        seeds[b] = 0;
+        if (!size[b])
+            continue;
+        for (seed = 1; seed <= MAX_SEED; ++seed) {
+            int clash = 0;
+            for (int i = 0; i < NENTRIES && !clash; ++i) {
+                if (bucket_of[i] != b)
+                    continue;
+                slot_of[i] = midr_hash(entries[i].key, seed) & (table_size - 1);
+                clash = used[slot_of[i]];
+                // Two keys of the bucket in one slot
+                for (int j = 0; j < i && !clash; ++j)
+                    clash = bucket_of[j] == b && slot_of[j] == slot_of[i];
+            }
+            if (!clash)
+                break;
+        }
+        if (seed > MAX_SEED) {
+            ok = 0;
+            break;
+        }
+        seeds[b] = seed;
+        for (int i = 0; i < NENTRIES; ++i)
+            if (bucket_of[i] == b)
+                used[slot_of[i]] = 1;
+    }
+    free(order);
+    free(size);
+    free(used);
+    return ok ? 0 : -1;
+}
+
+int main() {
+    if (compute_keys() < 0)
+        return 1;
+
+    // The smallest table, then the fewest buckets, that can be placed
+    for (table_size = 1; table_size < NENTRIES; table_size <<= 1)
+        ;
+    for (;; table_size <<= 1) {
+        for (nbuckets = NENTRIES / 4 + 1; nbuckets <= NENTRIES; nbuckets *= 2)
+            if (place() == 0)
+                goto placed;
+    }
+
+placed:
+    printf("/* Generated by midr-gen from midr.def, do not edit */\n\n");
+    printf("#define MIDR_BUCKETS %d\n", nbuckets);
+    printf("#define MIDR_TABLE_SIZE %d\n\n", table_size);
+
+    printf("static const uint16_t midr_seeds[MIDR_BUCKETS] = {");
+    for (int b = 0; b < nbuckets; ++b)
+        printf("%s%u,", b % 12 ? " " : "\n    ", seeds[b]);
+    printf("\n};\n\n");
+
+    printf("static const midr_core_t midr_table[MIDR_TABLE_SIZE] = {\n");
+    for (int slot = 0; slot < table_size; ++slot) {
+        for (int i = 0; i < NENTRIES; ++i) {
+            const entry_t *e = &entries[i];
+            if (slot_of[i] != slot)
+                continue;
+            printf("    [%d] = {%#010x, %s, %s, %s},\n", slot, e->key, e->name,
+                   e->mcpu, e->rank);
+        }
+    }
+    printf("};\n");
+    return 0;
+}
@@ -0,0 +1,121 @@
+/* Generated by midr-gen from midr.def, do not edit */
+
+#define MIDR_BUCKETS 28
+#define MIDR_TABLE_SIZE 128
+
+static const uint16_t midr_seeds[MIDR_BUCKETS] = {
+    19, 0, 1, 2, 5, 3, 2, 12, 53, 4, 2, 12,
+    6, 79, 1, 22, 11, 1, 8, 0, 31, 77, 11, 23,
+    41, 28, 16, 33,
+};
+
+static const midr_core_t midr_table[MIDR_TABLE_SIZE] = {
+    [0] = {0x4100d060, "Cortex-A65", "cortex-a65", RANK_LITTLE},
+    [1] = {0x51008000, "Kryo 2xx Gold", "cortex-a73", RANK_BIG},
+    [3] = {0x43000a30, "ThunderX 83XX", "thunderxt83", RANK_BIG},
+    [4] = {0x4100d4c0, "Cortex-X1C", "cortex-x1c", RANK_PRIME},
+    [5] = {0x61000220, "M1 Icestorm", "apple-m1", RANK_LITTLE},
+    [6] = {0x61000320, "M2 Blizzard", "apple-m2", RANK_LITTLE},
+    [7] = {0x4100d030, "Cortex-A53", "cortex-a53", RANK_LITTLE},
+    [8] = {0x4100c0d0, "Cortex-A12", "cortex-a12", RANK_BIG},
+    [9] = {0x4100c070, "Cortex-A7", "cortex-a7", RANK_LITTLE},
+    [10] = {0x50000000, "X-Gene", "xgene1", RANK_BIG},
+    [11] = {0x4100d800, "Cortex-A520", "cortex-a520", RANK_LITTLE},
+    [14] = {0x70006600, "FTC660", NULL, RANK_BIG},
+    [15] = {0x6d00d490, "Azure Cobalt 100", "neoverse-n2", RANK_BIG},
+    [16] = {0x4100d0b0, "Cortex-A76", "cortex-a76", RANK_BIG},
+    [17] = {0x4100d0c0, "Neoverse-N1", "neoverse-n1", RANK_BIG},
+    [18] = {0x4100b020, "ARM11 MPCore", "mpcore", RANK_UNKNOWN},
+    [19] = {0x42005160, "Vulcan", "thunderx2t99", RANK_BIG},
+    [20] = {0x4100d460, "Cortex-A510", "cortex-a510", RANK_LITTLE},
+    [22] = {0x61000240, "M1 Pro Icestorm", "apple-m1", RANK_LITTLE},
+    [23] = {0x51008020, "Kryo 3xx Gold", "cortex-a75", RANK_BIG},
+    [24] = {0x46000010, "A64FX", "a64fx", RANK_BIG},
+    [25] = {0x4100d0e0, "Cortex-A76AE", "cortex-a76ae", RANK_BIG},
+    [26] = {0x4100c0e0, "Cortex-A17", "cortex-a17", RANK_BIG},
+    [27] = {0x4e000040, "Carmel", "carmel", RANK_BIG},
+    [29] = {0x61000340, "M2 Pro Blizzard", "apple-m2", RANK_LITTLE},
+    [30] = {0x51008040, "Kryo 4xx Gold", "cortex-a76", RANK_BIG},
+    [31] = {0x43000a00, "ThunderX", "thunderx", RANK_BIG},
+    [32] = {0x4100d090, "Cortex-A73", "cortex-a73", RANK_BIG},
+    [33] = {0x4100b360, "ARM1136", "arm1136j-s", RANK_UNKNOWN},
+    [35] = {0x4400a110, "SA1100", "strongarm1100", RANK_UNKNOWN},
+    [36] = {0x4100d480, "Cortex-X2", "cortex-x2", RANK_PRIME},
+    [37] = {0x66005260, "FA526", "fa526", RANK_UNKNOWN},
+    [38] = {0x4100d820, "Cortex-X4", "cortex-x4", RANK_PRIME},
+    [39] = {0x70006610, "FTC661", NULL, RANK_BIG},
+    [40] = {0x4100d810, "Cortex-A720", "cortex-a720", RANK_BIG},
+    [41] = {0x61000250, "M1 Pro Firestorm", "apple-m1", RANK_BIG},
+    [42] = {0x5100c000, "Falkor", "falkor", RANK_BIG},
+    [43] = {0x4100c080, "Cortex-A8", "cortex-a8", RANK_BIG},
+    [44] = {0xc000ac40, "Ampere-1a", "ampere1a", RANK_BIG},
+    [46] = {0x4100d8e0, "Neoverse-N3", "neoverse-n3", RANK_BIG},
+    [47] = {0x5100c010, "Saphira", "saphira", RANK_BIG},
+    [48] = {0x42001000, "Brahma-B53", NULL, RANK_LITTLE},
+    [49] = {0x4100d850, "Cortex-X925", "cortex-x925", RANK_PRIME},
+    [50] = {0x510002d0, "Scorpion", NULL, RANK_UNKNOWN},
+    [51] = {0x43000b80, "ThunderX3 T110", "thunderx3t110", RANK_BIG},
+    [52] = {0x56005810, "PJ4/PJ4b", NULL, RANK_UNKNOWN},
+    [53] = {0x70006630, "FTC663", NULL, RANK_BIG},
+    [54] = {0x4100d0d0, "Cortex-A77", "cortex-a77", RANK_BIG},
+    [55] = {0x51002110, "Kryo", "kryo", RANK_BIG},
+    [56] = {0x61000390, "M2 Max Avalanche", "apple-m2", RANK_BIG},
+    [57] = {0x4100d440, "Cortex-X1", "cortex-x1", RANK_PRIME},
+    [58] = {0x4100d400, "Neoverse-V1", "neoverse-v1", RANK_BIG},
+    [59] = {0x510004d0, "Krait", NULL, RANK_BIG},
+    [60] = {0x4100d070, "Cortex-A57", "cortex-a57", RANK_BIG},
+    [61] = {0x510000f0, "Scorpion", NULL, RANK_UNKNOWN},
+    [62] = {0x4100c090, "Cortex-A9", "cortex-a9", RANK_BIG},
+    [64] = {0x61000330, "M2 Avalanche", "apple-m2", RANK_BIG},
+    [65] = {0x4100d4b0, "Cortex-A78C", "cortex-a78c", RANK_BIG},
+    [66] = {0x4100d430, "Cortex-A65AE", "cortex-a65ae", RANK_LITTLE},
+    [67] = {0x70006620, "FTC662", NULL, RANK_BIG},
+    [68] = {0x4100d470, "Cortex-A710", "cortex-a710", RANK_BIG},
+    [69] = {0x56005840, "PJ4B-MP", NULL, RANK_UNKNOWN},
+    [70] = {0x4400a100, "SA110", "strongarm110", RANK_UNKNOWN},
+    [71] = {0x4100d4a0, "Neoverse-E1", "neoverse-e1", RANK_LITTLE},
+    [72] = {0x43000a10, "ThunderX 88XX", "thunderxt88", RANK_BIG},
+    [73] = {0x4100d0a0, "Cortex-A75", "cortex-a75", RANK_BIG},
+    [75] = {0x43000af0, "ThunderX2 99XX", "thunderx2t99", RANK_BIG},
+    [76] = {0x4100b760, "ARM1176", "arm1176jzf-s", RANK_UNKNOWN},
+    [77] = {0x4100d010, "Cortex-A32", "cortex-a32", RANK_LITTLE},
+    [78] = {0x4100d490, "Neoverse-N2", "neoverse-n2", RANK_BIG},
+    [79] = {0x4100d040, "Cortex-A35", "cortex-a35", RANK_LITTLE},
+    [80] = {0x4100d4e0, "Cortex-X3", "cortex-x3", RANK_PRIME},
+    [81] = {0xc000ac30, "Ampere-1", "ampere1", RANK_BIG},
+    [83] = {0x61000230, "M1 Firestorm", "apple-m1", RANK_BIG},
+    [84] = {0x43000a20, "ThunderX 81XX", "thunderxt81", RANK_BIG},
+    [86] = {0x51002010, "Kryo", "kryo", RANK_BIG},
+    [87] = {0x51002050, "Kryo", "kryo", RANK_BIG},
+    [88] = {0x66006260, "FA626", "fa626", RANK_UNKNOWN},
+    [90] = {0x51008050, "Kryo 4xx Silver", "cortex-a55", RANK_LITTLE},
+    [91] = {0x4e000030, "Denver 2", NULL, RANK_BIG},
+    [92] = {0x51000010, "Oryon", "oryon-1", RANK_PRIME},
+    [93] = {0x51008030, "Kryo 3xx Silver", "cortex-a55", RANK_LITTLE},
+    [94] = {0x4100d420, "Cortex-A78AE", "cortex-a78ae", RANK_BIG},
+    [95] = {0x61000280, "M1 Max Icestorm", "apple-m1", RANK_LITTLE},
+    [98] = {0x4100d4f0, "Neoverse-V2", "neoverse-v2", RANK_BIG},
+    [99] = {0x69002000, "i80200", "xscale", RANK_UNKNOWN},
+    [101] = {0x51008010, "Kryo 2xx Silver", "cortex-a53", RANK_LITTLE},
+    [102] = {0x4100c0f0, "Cortex-A15", "cortex-a15", RANK_BIG},
+    [103] = {0x4100d080, "Cortex-A72", "cortex-a72", RANK_BIG},
+    [104] = {0x4e000000, "Denver", NULL, RANK_BIG},
+    [106] = {0x56001310, "Feroceon 88FR131", NULL, RANK_UNKNOWN},
+    [107] = {0x510006f0, "Krait", NULL, RANK_BIG},
+    [108] = {0x4100b560, "ARM1156", "arm1156t2-s", RANK_UNKNOWN},
+    [109] = {0x61000380, "M2 Max Blizzard", "apple-m2", RANK_LITTLE},
+    [110] = {0x61000290, "M1 Max Firestorm", "apple-m1", RANK_BIG},
+    [111] = {0x4100c050, "Cortex-A5", "cortex-a5", RANK_LITTLE},
+    [112] = {0x4100d410, "Cortex-A78", "cortex-a78", RANK_BIG},
+    [113] = {0x4100d840, "Neoverse-V3", "neoverse-v3", RANK_BIG},
+    [114] = {0x4800d010, "TaiShan-v110", "tsv110", RANK_BIG},
+    [115] = {0x61000350, "M2 Pro Avalanche", "apple-m2", RANK_BIG},
+    [116] = {0x420000f0, "Brahma-B15", NULL, RANK_BIG},
+    [117] = {0x53000010, "Exynos-M1", "exynos-m1", RANK_BIG},
+    [118] = {0x4100d870, "Cortex-A725", "cortex-a725", RANK_BIG},
+    [120] = {0x4100d050, "Cortex-A55", "cortex-a55", RANK_LITTLE},
+    [121] = {0x4100d4d0, "Cortex-A715", "cortex-a715", RANK_BIG},
+    [122] = {0x69004110, "PXA27x", "iwmmxt", RANK_UNKNOWN},
+    [124] = {0x69006820, "PXA32x", "iwmmxt2", RANK_UNKNOWN},
+    [127] = {0x6900b110, "SA1110", "strongarm1100", RANK_UNKNOWN},
+};
@@ -0,0 +1,50 @@
+/* Database of ARM implementers and core types keyed by MIDR
+ *
+ * Copyright (c) 2014, 2024 Evgeny Yulyugin.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *   * Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *   * Redistributions in binary form must reproduce the above copyright
+ *     notice, this list of conditions and the following disclaimer in the
+ *     documentation and/or other materials provided with the distribution.
+ *   * The names of its contributors may be used to endorse or promote products
+ *     derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR
+ * ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include <stdint.h>
+#include <stddef.h>
+
+#include "midr.h"
+#include "midr-table.h"
+
+static const char *const midr_vendors[256] = {
+#define VENDOR(implementer, name) [implementer] = name,
+#define CORE(implementer, part, name, rank, mcpu)
+#include "midr.def"
+#undef VENDOR
+#undef CORE
+};
+
+const midr_core_t *midr_lookup(uint32_t midr) {
+    uint32_t key = midr_key(midr);
+    uint32_t seed = midr_seeds[midr_hash(key, 0) % MIDR_BUCKETS];
+    const midr_core_t *c = &midr_table[midr_hash(key, seed) & (MIDR_TABLE_SIZE - 1)];
+    return c->name && c->key == key ? c : NULL;
+}
+
+const char *midr_vendor(uint32_t midr) {
+    return midr_vendors[(midr >> 24) & 0xff];
+}
@@ -0,0 +1,72 @@
+/* Database of ARM implementers and core types keyed by MIDR
+ *
+ * Copyright (c) 2014, 2024 Evgeny Yulyugin.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *   * Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *   * Redistributions in binary form must reproduce the above copyright
+ *     notice, this list of conditions and the following disclaimer in the
+ *     documentation and/or other materials provided with the distribution.
+ *   * The names of its contributors may be used to endorse or promote products
+ *     derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR
+ * ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifndef GGG_MIDR_H
+#define GGG_MIDR_H
+
+#include <stdint.h>
+
+/* Relative performance of a core type within one system */
+enum {
+    RANK_UNKNOWN,
+    RANK_LITTLE,
+    RANK_BIG,
+    RANK_PRIME,
+};
+
+typedef struct {
+    uint32_t key;           /* see midr_key() */
+    const char *name;
+    const char *mcpu;       /* GCC and Clang -mcpu= value, NULL if none */
+    int rank;
+} midr_core_t;
+
+/* Hash keys are the implementer and part number fields of MIDR. Variant
+ * and revision are ignored, and so is the architecture field: it is 0xf
+ * on cores with the CPUID identification scheme, but pre-ARMv7 cores and
+ * some implementer-defined MIDRs use other values. */
+static inline uint32_t midr_key(uint32_t midr) {
+    return midr & 0xff00fff0u;
+}
+
+/* Murmur3 finalizer, seeds select the functions of the perfect hash */
+static inline uint32_t midr_hash(uint32_t key, uint32_t seed) {
+    uint32_t h = key ^ (seed * 0x9e3779b9u);
+    h ^= h >> 16;
+    h *= 0x85ebca6bu;
+    h ^= h >> 13;
+    h *= 0xc2b2ae35u;
+    h ^= h >> 16;
+    return h;
+}
+
+/* Core type of a MIDR, NULL if unknown */
+const midr_core_t *midr_lookup(uint32_t midr);
+
+/* Name of the implementer in MIDR bits 31:24, NULL if unknown */
+const char *midr_vendor(uint32_t midr);
+
+#endif /* GGG_MIDR_H */
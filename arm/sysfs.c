@@ -0,0 +1,196 @@
+/* Per-CPU identification registers from sysfs
+ *
+ * Copyright (c) 2014, 2024 Evgeny Yulyugin.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *   * Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *   * Redistributions in binary form must reproduce the above copyright
+ *     notice, this list of conditions and the following disclaimer in the
+ *     documentation and/or other materials provided with the distribution.
+ *   * The names of its contributors may be used to endorse or promote products
+ *     derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR
+ * ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/* Unlike MRS, which reports the CPU the caller happens to run on, sysfs
+ * has the registers of every core, so big.LITTLE systems show all their
+ * core types. Files are opened relative to one directory descriptor and
+ * read with a single pread each; on many-core servers the CPUs are split
+ * between a few threads. */
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <pthread.h>
+
+#include "sysfs.h"
+
+#define SYSFS_CPU "/sys/devices/system/cpu"
+
+/* CPUs read by one thread at least, to not pay for threads on phones */
+#define CPUS_PER_THREAD 32
+#define MAX_THREADS 8
+
+typedef struct {
+    int dirfd;
+    cpu_ident_t *idents;
+    int first;
+    int count;
+    int failed;
+} sysfs_job_t;
+
+static int read_reg(int dirfd, int cpu, const char *reg, uint64_t *val) {
+    char path[96], buf[32];
+
+    snprintf(path, sizeof(path), "cpu%d/regs/identification/%s", cpu, reg);
+    int fd = openat(dirfd, path, O_RDONLY | O_CLOEXEC);
+    if (fd < 0)
+        return -1;
+    ssize_t n = pread(fd, buf, sizeof(buf) - 1, 0);
+    close(fd);
+    if (n <= 0)
+        return -1;
+    buf[n] = '\0';
+    *val = strtoull(buf, NULL, 16);
+    return 0;
+}
+
+static void *read_range(void *arg) {
+    sysfs_job_t *job = arg;
+
+    for (int i = job->first; i < job->first + job->count; ++i) {
+        cpu_ident_t *id = &job->idents[i];
+        if (read_reg(job->dirfd, id->cpu, "midr_el1", &id->midr) < 0)
+            job->failed = 1;
+        // REVIDR is missing on kernels before 4.11
+        if (read_reg(job->dirfd, id->cpu, "revidr_el1", &id->revidr) < 0)
+            id->revidr = 0;
+    }
+    return NULL;
+}
+
+/* Expand a CPU list such as "0-3,6" of the online file */
+static int online_cpus(int dirfd, int **cpus) {
+    char buf[4096];
+    int fd = openat(dirfd, "online", O_RDONLY | O_CLOEXEC);
+    if (fd < 0)
+        return -1;
+    ssize_t len = pread(fd, buf, sizeof(buf) - 1, 0);
+    close(fd);
+    if (len <= 0)
+        return -1;
+    buf[len] = '\0';
+
+    int n = 0, cap = 64;
+    *cpus = malloc(cap * sizeof(int));
+    for (char *p = buf; *cpus && *p && *p != '\n'; ) {
+        char *end;
+        long first = strtol(p, &end, 10), last = first;
+        if (end == p)
+            break;
+        if (*end == '-')
+            last = strtol(end + 1, &end, 10);
+        for (long cpu = first; cpu <= last; ++cpu) {
+            if (n == cap) {
+                int *grown = realloc(*cpus, 2 * cap * sizeof(int));
+                if (!grown) {
+                    free(*cpus);
+                    *cpus = NULL;
+                    return -1;
+                }
+                *cpus = grown;
+                cap *= 2;
+            }
+            (*cpus)[n++] = cpu;
+        }
+        p = *end == ',' ? end + 1 : end;
+    }
+    return *cpus ? n : -1;
+}
+
+int sysfs_read_idents(cpu_ident_t **idents) {
+    int dirfd = open(SYSFS_CPU, O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+    int *cpus = NULL;
+
+    if (dirfd < 0)
+        return -1;
+    int n = online_cpus(dirfd, &cpus);
+    if (n <= 0) {
+        close(dirfd);
+        return -1;
+    }
+
+    *idents = calloc(n, sizeof(cpu_ident_t));
+    if (!*idents) {
+        free(cpus);
+        close(dirfd);
+        return -1;
+    }
+    for (int i = 0; i < n; ++i)
+        (*idents)[i].cpu = cpus[i];
+    free(cpus);
+
+    int nthreads = (n + CPUS_PER_THREAD - 1) / CPUS_PER_THREAD;
+    if (nthreads > MAX_THREADS)
+        nthreads = MAX_THREADS;
+
+    sysfs_job_t jobs[MAX_THREADS];
+    pthread_t threads[MAX_THREADS];
+    int started[MAX_THREADS] = {0};
+    int failed = 0;
+    for (int t = 0; t < nthreads; ++t) {
+        jobs[t].dirfd = dirfd;
+        jobs[t].idents = *idents;
+        jobs[t].first = n * t / nthreads;
+        jobs[t].count = n * (t + 1) / nthreads - jobs[t].first;
+        jobs[t].failed = 0;
+        // The calling thread takes the first range itself
+        if (t > 0) {
+            started[t] = !pthread_create(&threads[t], NULL, read_range, &jobs[t]);
+            if (!started[t])
+                read_range(&jobs[t]);
+        }
+    }
+    read_range(&jobs[0]);
+    for (int t = 1; t < nthreads; ++t)
+        if (started[t])
+            pthread_join(threads[t], NULL);
+    for (int t = 0; t < nthreads; ++t)
+        failed |= jobs[t].failed;
+    close(dirfd);
+
+    if (failed) {
+        free(*idents);
+        *idents = NULL;
+        return -1;
+    }
+    return n;
+}
+
+int sysfs_read_ident(int cpu, cpu_ident_t *id) {
+    int dirfd = open(SYSFS_CPU, O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+
+    if (dirfd < 0)
+        return -1;
+    id->cpu = cpu;
+    int ret = read_reg(dirfd, cpu, "midr_el1", &id->midr);
+    if (ret == 0 && read_reg(dirfd, cpu, "revidr_el1", &id->revidr) < 0)
+        id->revidr = 0;
+    close(dirfd);
+    return ret;
+}
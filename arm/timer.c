@@ -0,0 +1,164 @@
+/* ARM generic timer as a clock for benchmarks
+ *
+ * Copyright (c) 2014, 2024 Evgeny Yulyugin.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *   * Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *   * Redistributions in binary form must reproduce the above copyright
+ *     notice, this list of conditions and the following disclaimer in the
+ *     documentation and/or other materials provided with the distribution.
+ *   * The names of its contributors may be used to endorse or promote products
+ *     derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR
+ * ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/* The generic timer counts at a fixed frequency on every core, so unlike
+ * cycle counters it needs no frequency scaling correction, and reading it
+ * costs a few instructions instead of a vDSO call. Linux lets user space
+ * read CNTVCT whenever it uses the timer as its clocksource. CNTFRQ is
+ * set by firmware and sometimes wrong, so it is checked by measurement. */
+
+#include <stdint.h>
+#include <inttypes.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "timer.h"
+#include "device.h"
+
+#define CLOCKSOURCE "/sys/devices/system/clocksource/clocksource0/current_clocksource"
+
+#define NSEC_PER_SEC 1000000000ull
+
+/* Measured and programmed frequencies differing by more than 1/100 */
+#define TOLERANCE 100
+
+#define CALIBRATION_NS 10000000
+
+#if defined(__aarch64__) || defined(__arm__)
+
+static uint64_t read_cntfrq(void) {
+#ifdef __aarch64__
+    uint64_t v;
+    __asm__ __volatile__ ("mrs %0, cntfrq_el0" : "=r" (v));
+    return v;
+#else
+    // PL0 may read CNTFRQ only if the kernel enabled user access to a
+    // counter, the driver captures it regardless
+    uint32_t *regs;
+    uint64_t freq = 0;
+    int n;
+
+    if ((regs = device_map_regs(&n)) != NULL) {
+        for (int i = 0; i < n && !freq; ++i)
+            freq = regs[i * GGG_NREGS + GGG_CNTFRQ];
+        free(regs);
+    }
+    return freq;
+#endif
+}
+
+static int counter_readable(void) {
+#ifdef __aarch64__
+    return 1;
+#else
+    char buf[32] = "";
+    FILE *f = fopen(CLOCKSOURCE, "r");
+
+    if (!f)
+        return 0;
+    if (!fgets(buf, sizeof(buf), f))
+        buf[0] = '\0';
+    fclose(f);
+    return !strncmp(buf, "arch_sys_counter", 16);
+#endif
+}
+
+#else
+
+static uint64_t read_cntfrq(void) {
+    return 0;
+}
+
+static int counter_readable(void) {
+    return 0;
+}
+
+#endif
+
+static uint64_t monotonic_ns(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC_RAW, &ts);
+    return ts.tv_sec * NSEC_PER_SEC + ts.tv_nsec;
+}
+
+int timer_init(timer_info_t *info) {
+    memset(info, 0, sizeof(*info));
+    if (!counter_readable())
+        return -1;
+    info->cntfrq = read_cntfrq();
+
+    // Bracket the counter reads with clock reads, so that the interval
+    // covers the counter interval
+    struct timespec pause = {0, CALIBRATION_NS};
+    uint64_t t0 = monotonic_ns(), c0 = timer_read_serialized();
+    nanosleep(&pause, NULL);
+    uint64_t c1 = timer_read_serialized(), t1 = monotonic_ns();
+    if (t1 == t0 || c1 == c0)
+        return -1;
+    uint64_t measured = (c1 - c0) * NSEC_PER_SEC / (t1 - t0);
+
+    uint64_t diff = measured > info->cntfrq ? measured - info->cntfrq
+                                            : info->cntfrq - measured;
+    if (!info->cntfrq || diff > info->cntfrq / TOLERANCE) {
+        info->freq = measured;
+        info->calibrated = 1;
+    } else {
+        info->freq = info->cntfrq;
+    }
+    return 0;
+}
+
+uint64_t timer_ticks_to_ns(const timer_info_t *info, uint64_t ticks) {
+    return ticks / info->freq * NSEC_PER_SEC
+           + ticks % info->freq * NSEC_PER_SEC / info->freq;
+}
+
+void print_timer(FILE *f, const timer_info_t *info) {
+    enum { READS = 100000 };
+    struct timespec ts;
+
+    if (info->cntfrq)
+        fprintf(f, "CNTFRQ: %" PRIu64 " Hz\n", info->cntfrq);
+    else
+        fprintf(f, "CNTFRQ: unknown\n");
+    if (info->calibrated)
+        fprintf(f, "Measured frequency: %" PRIu64 " Hz, used instead\n", info->freq);
+    fprintf(f, "Resolution: %.1f ns\n", (double)NSEC_PER_SEC / info->freq);
+
+    uint64_t c0 = timer_read_serialized();
+    for (int i = 0; i < READS; ++i)
+        timer_read_serialized();
+    uint64_t c1 = timer_read_serialized();
+    for (int i = 0; i < READS; ++i)
+        clock_gettime(CLOCK_MONOTONIC, &ts);
+    uint64_t c2 = timer_read_serialized();
+
+    fprintf(f, "Serialized timestamp: %.1f ns, clock_gettime(): %.1f ns\n",
+            (double)timer_ticks_to_ns(info, c1 - c0) / READS,
+            (double)timer_ticks_to_ns(info, c2 - c1) / READS);
+}
@@ -0,0 +1,83 @@
+/* ARM generic timer as a clock for benchmarks
+ *
+ * Copyright (c) 2014, 2024 Evgeny Yulyugin.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *   * Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *   * Redistributions in binary form must reproduce the above copyright
+ *     notice, this list of conditions and the following disclaimer in the
+ *     documentation and/or other materials provided with the distribution.
+ *   * The names of its contributors may be used to endorse or promote products
+ *     derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR
+ * ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifndef GGG_TIMER_H
+#define GGG_TIMER_H
+
+#include <stdio.h>
+#include <stdint.h>
+
+typedef struct {
+    uint64_t cntfrq;        /* as programmed by firmware, 0 if unknown */
+    uint64_t freq;          /* ticks per second used for conversions */
+    int calibrated;         /* freq was measured, CNTFRQ being off or unknown */
+} timer_info_t;
+
+/* Virtual count of the generic timer, the clock behind clock_gettime() on
+ * ARM Linux. Reads may be reordered with the surrounding instructions. */
+static inline uint64_t timer_read(void) {
+#if defined(__aarch64__)
+    uint64_t v;
+    __asm__ __volatile__ ("mrs %0, cntvct_el0" : "=r" (v));
+    return v;
+#elif defined(__arm__)
+    uint32_t lo, hi;
+    __asm__ __volatile__ ("mrrc p15, 1, %0, %1, c14" : "=r" (lo), "=r" (hi));
+    return (uint64_t)hi << 32 | lo;
+#else
+    return 0;
+#endif
+}
+
+/* Count after all earlier instructions complete: ISB keeps the read from
+ * being speculated ahead of the code being timed */
+static inline uint64_t timer_read_serialized(void) {
+#if defined(__aarch64__)
+    uint64_t v;
+    __asm__ __volatile__ ("isb\n\tmrs %0, cntvct_el0" : "=r" (v) : : "memory");
+    return v;
+#elif defined(__arm__)
+    uint32_t lo, hi;
+    __asm__ __volatile__ ("isb\n\tmrrc p15, 1, %0, %1, c14"
+                          : "=r" (lo), "=r" (hi) : : "memory");
+    return (uint64_t)hi << 32 | lo;
+#else
+    return 0;
+#endif
+}
+
+/* Frequency from CNTFRQ (on ARMv7 captured by ggg-driver), checked against
+ * CLOCK_MONOTONIC_RAW over 10 ms. Returns -1 if user space cannot read the
+ * counter. */
+int timer_init(timer_info_t *info);
+
+/* Nanoseconds in a number of ticks, exact for any count */
+uint64_t timer_ticks_to_ns(const timer_info_t *info, uint64_t ticks);
+
+/* Print frequencies, resolution and the cost of a timestamp */
+void print_timer(FILE *f, const timer_info_t *info);
+
+#endif /* GGG_TIMER_H */
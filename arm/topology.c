@@ -0,0 +1,234 @@
+/* Cluster topology and core types of ARM systems
+ *
+ * Copyright (c) 2014, 2024 Evgeny Yulyugin.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *   * Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *   * Redistributions in binary form must reproduce the above copyright
+ *     notice, this list of conditions and the following disclaimer in the
+ *     documentation and/or other materials provided with the distribution.
+ *   * The names of its contributors may be used to endorse or promote products
+ *     derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR
+ * ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/* MPIDR numbers cores by affinity levels: with the MT bit set Aff0 is a
+ * thread, Aff1 a core and Aff2 the cluster (DynamIQ cores use this layout
+ * without being multithreaded), otherwise Aff0 is the core and Aff1 the
+ * cluster. The kernel's cpu_capacity tells big cores from little ones; the
+ * rank of the core type in midr.def stands in for it on older kernels. */
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "topology.h"
+#include "device.h"
+#include "midr.h"
+#include "sysfs.h"
+
+#define SYSFS_CPU "/sys/devices/system/cpu"
+
+#define MPIDR_MT (1u << 24)
+
+#define CAPACITY_MAX 1024
+
+static int read_int(int cpu, const char *file, long *val) {
+    char path[128];
+
+    snprintf(path, sizeof(path), SYSFS_CPU "/cpu%d/%s", cpu, file);
+    FILE *f = fopen(path, "r");
+    if (!f)
+        return -1;
+    int ok = fscanf(f, "%ld", val) == 1;
+    fclose(f);
+    return ok ? 0 : -1;
+}
+
+static void decode_mpidr(arm_cpu_t *c) {
+    uint32_t aff0 = c->mpidr & 0xff, aff1 = (c->mpidr >> 8) & 0xff;
+    uint32_t aff2 = (c->mpidr >> 16) & 0xff, aff3 = (c->mpidr >> 32) & 0xff;
+
+    if (c->mpidr & MPIDR_MT) {
+        c->core = aff1;
+        c->cluster = aff2 | aff3 << 8;
+    } else {
+        c->core = aff0;
+        c->cluster = aff1 | aff2 << 8;
+    }
+}
+
+/* Unknown core types count as big ones */
+static int core_rank(uint32_t midr) {
+    const midr_core_t *core = midr_lookup(midr);
+    return core && core->rank != RANK_UNKNOWN ? core->rank : RANK_BIG;
+}
+
+/* Capacities from sysfs, or ranks of known core types scaled so that the
+ * best one gets CAPACITY_MAX */
+static void fill_capacity(arm_cpu_t *cpus, int n) {
+    int from_sysfs = 1, best = 1;
+
+    for (int i = 0; i < n; ++i) {
+        long cap;
+        if (read_int(cpus[i].cpu, "cpu_capacity", &cap) < 0) {
+            from_sysfs = 0;
+            break;
+        }
+        cpus[i].capacity = cap;
+    }
+    if (from_sysfs)
+        return;
+
+    for (int i = 0; i < n; ++i) {
+        int rank = core_rank(cpus[i].midr);
+        if (rank > best)
+            best = rank;
+    }
+    for (int i = 0; i < n; ++i)
+        cpus[i].capacity = CAPACITY_MAX * core_rank(cpus[i].midr) / best;
+}
+
+int topology_read(arm_cpu_t **cpus) {
+    uint32_t *regs;
+    cpu_ident_t *ids;
+    int n;
+
+    if ((regs = device_map_regs(&n)) != NULL) {
+        int count = 0;
+        *cpus = calloc(n, sizeof(arm_cpu_t));
+        for (int i = 0; *cpus && i < n; ++i) {
+            const uint32_t *r = regs + i * GGG_NREGS;
+            // Never online since the driver was loaded
+            if (!r[GGG_MIDR])
+                continue;
+            arm_cpu_t *c = &(*cpus)[count++];
+            c->cpu = i;
+            c->midr = r[GGG_MIDR];
+            c->has_mpidr = 1;
+            c->mpidr = r[GGG_MPIDR];
+            decode_mpidr(c);
+        }
+        free(regs);
+        n = count;
+    } else if ((n = sysfs_read_idents(&ids)) >= 0) {
+        // AArch64 kernels do not publish MPIDR but its decoded levels
+        *cpus = calloc(n, sizeof(arm_cpu_t));
+        for (int i = 0; *cpus && i < n; ++i) {
+            arm_cpu_t *c = &(*cpus)[i];
+            long id;
+            c->cpu = ids[i].cpu;
+            c->midr = ids[i].midr;
+            if (read_int(c->cpu, "topology/cluster_id", &id) < 0
+                && read_int(c->cpu, "topology/physical_package_id", &id) < 0)
+                id = 0;
+            c->cluster = id;
+            c->core = read_int(c->cpu, "topology/core_id", &id) < 0 ? c->cpu : id;
+        }
+        free(ids);
+    } else {
+        return -1;
+    }
+    if (!*cpus)
+        return -1;
+
+    for (int i = 0; i < n; ++i) {
+        const midr_core_t *core = midr_lookup((*cpus)[i].midr);
+        (*cpus)[i].name = core ? core->name : NULL;
+    }
+    fill_capacity(*cpus, n);
+    return n;
+}
+
+/* CPU numbers as ranges, e.g. "0-3,6" */
+static void print_cpu_list(FILE *f, const int *list, int n) {
+    for (int i = 0; i < n; ) {
+        int j = i;
+        while (j + 1 < n && list[j + 1] == list[j] + 1)
+            j++;
+        fprintf(f, "%s%d", i ? "," : "", list[i]);
+        if (j > i)
+            fprintf(f, "-%d", list[j]);
+        i = j + 1;
+    }
+}
+
+/* CPUs matching a cluster (or any with -1) and a capacity range */
+static int select_cpus(const arm_cpu_t *cpus, int n, int cluster,
+                       unsigned min_cap, unsigned max_cap, int *out) {
+    int count = 0;
+
+    for (int i = 0; i < n; ++i)
+        if ((cluster < 0 || cpus[i].cluster == cluster)
+            && cpus[i].capacity >= min_cap && cpus[i].capacity <= max_cap)
+            out[count++] = cpus[i].cpu;
+    return count;
+}
+
+void print_topology(FILE *f, const arm_cpu_t *cpus, int n) {
+    int *list = malloc(n * sizeof(int));
+    unsigned max_cap = 0, min_cap = ~0u;
+
+    if (!list)
+        return;
+
+    fprintf(f, "CPU  Cluster  Core  Affinity      Capacity  Core type\n");
+    for (int i = 0; i < n; ++i) {
+        const arm_cpu_t *c = &cpus[i];
+        char aff[16] = "-";
+        if (c->has_mpidr)
+            snprintf(aff, sizeof(aff), "%u.%u.%u.%u",
+                     (unsigned)(c->mpidr >> 32) & 0xff, (unsigned)(c->mpidr >> 16) & 0xff,
+                     (unsigned)(c->mpidr >> 8) & 0xff, (unsigned)c->mpidr & 0xff);
+        fprintf(f, "%3d  %7d  %4d  %-12s  %8u  ", c->cpu, c->cluster, c->core,
+                aff, c->capacity);
+        if (c->name)
+            fprintf(f, "%s\n", c->name);
+        else
+            fprintf(f, "implementer %#x part %#x\n", c->midr >> 24,
+                    (c->midr >> 4) & 0xfff);
+        if (c->capacity > max_cap)
+            max_cap = c->capacity;
+        if (c->capacity < min_cap)
+            min_cap = c->capacity;
+    }
+
+    // The cluster with most of the fastest cores keeps latency-critical
+    // threads together on a shared cache
+    int best_cluster = -1, best_count = 0;
+    for (int i = 0; i < n; ++i) {
+        int count = select_cpus(cpus, n, cpus[i].cluster, max_cap, max_cap, list);
+        if (count > best_count) {
+            best_count = count;
+            best_cluster = cpus[i].cluster;
+        }
+    }
+
+    fprintf(f, "\nAffinity plans:\n");
+    fprintf(f, "  latency-critical: ");
+    print_cpu_list(f, list, select_cpus(cpus, n, best_cluster, max_cap, max_cap, list));
+    fprintf(f, " (fastest cores of cluster %d)\n", best_cluster);
+    fprintf(f, "  big cores:        ");
+    print_cpu_list(f, list, select_cpus(cpus, n, -1, max_cap, max_cap, list));
+    fprintf(f, "\n");
+    if (min_cap < max_cap) {
+        fprintf(f, "  background:       ");
+        print_cpu_list(f, list, select_cpus(cpus, n, -1, min_cap, min_cap, list));
+        fprintf(f, " (slowest cores)\n");
+    }
+    free(list);
+}
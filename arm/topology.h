@@ -0,0 +1,52 @@
+/* Cluster topology and core types of ARM systems
+ *
+ * Copyright (c) 2014, 2024 Evgeny Yulyugin.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *   * Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *   * Redistributions in binary form must reproduce the above copyright
+ *     notice, this list of conditions and the following disclaimer in the
+ *     documentation and/or other materials provided with the distribution.
+ *   * The names of its contributors may be used to endorse or promote products
+ *     derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR
+ * ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifndef GGG_TOPOLOGY_H
+#define GGG_TOPOLOGY_H
+
+#include <stdio.h>
+#include <stdint.h>
+
+typedef struct {
+    int cpu;
+    uint32_t midr;
+    int has_mpidr;
+    uint64_t mpidr;
+    int cluster;            /* from MPIDR affinity levels or sysfs */
+    int core;               /* within the cluster */
+    unsigned capacity;      /* relative performance, 1024 for the fastest */
+    const char *name;       /* core type, NULL if unknown */
+} arm_cpu_t;
+
+/* Topology of all online CPUs from the driver (MPIDR) or sysfs. Returns
+ * the number of CPUs in a malloc'ed array, -1 if neither is available. */
+int topology_read(arm_cpu_t **cpus);
+
+/* Print the cluster map and affinity plans: latency-critical threads on
+ * the fastest cores of one cluster, background work on the slowest */
+void print_topology(FILE *f, const arm_cpu_t *cpus, int n);
+
+#endif /* GGG_TOPOLOGY_H */
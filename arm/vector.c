@@ -0,0 +1,191 @@
+/* SVE and SME vector lengths
+ *
+ * Copyright (c) 2014, 2024 Evgeny Yulyugin.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *   * Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *   * Redistributions in binary form must reproduce the above copyright
+ *     notice, this list of conditions and the following disclaimer in the
+ *     documentation and/or other materials provided with the distribution.
+ *   * The names of its contributors may be used to endorse or promote products
+ *     derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR
+ * ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/* The vector length is chosen by the implementation between 128 and 2048
+ * bits and may be lowered per thread by the kernel. RDVL and RDSVL are
+ * emitted as raw encodings for assemblers without SVE and SME, and run
+ * only when HWCAP says they will not trap. Probing the lengths the kernel
+ * accepts changes the length of the probing thread, so it runs in a
+ * thread of its own. */
+
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+#include <pthread.h>
+
+#include "vector.h"
+#include "aarch64.h"
+#include "hwcap.h"
+
+#ifdef __aarch64__
+#include <sys/prctl.h>
+#endif
+
+#ifndef PR_SVE_SET_VL
+#define PR_SVE_SET_VL 50
+#define PR_SVE_GET_VL 51
+#endif
+#ifndef PR_SME_SET_VL
+#define PR_SME_SET_VL 63
+#define PR_SME_GET_VL 64
+#endif
+#define VL_LEN_MASK 0xffff
+
+/* Architectural maximum, 2048 bits */
+#define VL_MAX_BYTES 256
+
+#ifdef __aarch64__
+
+unsigned sve_vector_bits(void) {
+    register uint64_t x0 __asm__("x0");
+
+    if (!hwcap_has(FEATURE_SVE))
+        return 0;
+    __asm__ __volatile__ (".inst 0x04bf5020" : "=r" (x0));  // rdvl x0, #1
+    return x0 * 8;
+}
+
+unsigned sme_vector_bits(void) {
+    register uint64_t x0 __asm__("x0");
+
+    if (!hwcap_has(FEATURE_SME))
+        return 0;
+    __asm__ __volatile__ (".inst 0x04bf5820" : "=r" (x0));  // rdsvl x0, #1
+    return x0 * 8;
+}
+
+typedef struct {
+    int set_option;
+    int count;
+    unsigned *lengths;
+} probe_t;
+
+/* The kernel rounds a requested length down to one the CPU supports, or
+ * up to the smallest one if the request is below it (SME may have no
+ * 128-bit length). Asking for every power of two from the top finds all
+ * of them, and a length no shorter than the request is the smallest. */
+static void *probe_lengths(void *arg) {
+    probe_t *p = arg;
+
+    for (unsigned bytes = VL_MAX_BYTES; bytes >= 16 && p->count < VECTOR_MAX_LENGTHS;
+         bytes /= 2) {
+        int ret = prctl(p->set_option, bytes, 0, 0, 0);
+        if (ret < 0)
+            break;
+        unsigned vl = ret & VL_LEN_MASK;
+        if (p->count && vl * 8 == p->lengths[0])
+            break;
+        memmove(p->lengths + 1, p->lengths, p->count * sizeof(unsigned));
+        p->lengths[0] = vl * 8;
+        p->count++;
+        if (p->count > 1 && vl >= bytes)
+            break;
+        // Nothing between the request and the length it rounded down to
+        bytes = vl;
+    }
+    return NULL;
+}
+
+static int probe(int set_option, unsigned *lengths) {
+    probe_t p = {set_option, 0, lengths};
+    pthread_t thread;
+
+    if (pthread_create(&thread, NULL, probe_lengths, &p) != 0)
+        return 0;
+    pthread_join(thread, NULL);
+    return p.count;
+}
+
+void vector_info(vector_info_t *info) {
+    uint64_t regs[AA64_NREGS];
+
+    memset(info, 0, sizeof(*info));
+    if (hwcap_has(FEATURE_SVE)) {
+        info->sve = 1;
+        // ZFR0.SVEver is 0 for SVE, 1 for SVE2, 2 for SVE2.1
+        if (aa64_read_id_regs(regs) == 0)
+            info->sve += regs[AA64_ZFR0] & 0xf;
+        else if (hwcap_has(FEATURE_SVE2))
+            info->sve = 2;
+        info->sve_bits = sve_vector_bits();
+        info->nsve_lengths = probe(PR_SVE_SET_VL, info->sve_lengths);
+    }
+    if (hwcap_has(FEATURE_SME)) {
+        info->sme = hwcap_has(FEATURE_SME2) ? 2 : 1;
+        // SMFR0.FA64 is bit 63
+        if (aa64_read_id_regs(regs) == 0)
+            info->fa64 = regs[AA64_SMFR0] >> 63;
+        info->sme_bits = sme_vector_bits();
+        info->nsme_lengths = probe(PR_SME_SET_VL, info->sme_lengths);
+    }
+}
+
+#else
+
+unsigned sve_vector_bits(void) {
+    return 0;
+}
+
+unsigned sme_vector_bits(void) {
+    return 0;
+}
+
+void vector_info(vector_info_t *info) {
+    memset(info, 0, sizeof(*info));
+}
+
+#endif
+
+static void print_lengths(FILE *f, const unsigned *lengths, int n) {
+    fprintf(f, ", supported");
+    for (int i = 0; i < n; ++i)
+        fprintf(f, " %u", lengths[i]);
+}
+
+void print_vectors(FILE *f, const vector_info_t *info) {
+    static const char *sve_versions[] = {"", "SVE", "SVE2", "SVE2.1"};
+
+    if (info->sve) {
+        fprintf(f, "SVE: %s, vector length %u bits",
+                info->sve < 4 ? sve_versions[info->sve] : "SVE2.1+", info->sve_bits);
+        if (info->nsve_lengths)
+            print_lengths(f, info->sve_lengths, info->nsve_lengths);
+        fprintf(f, "\n");
+    } else {
+        fprintf(f, "SVE: no\n");
+    }
+
+    if (info->sme) {
+        fprintf(f, "SME: SME%s%s, streaming vector length %u bits",
+                info->sme > 1 ? "2" : "", info->fa64 ? " with FA64" : "",
+                info->sme_bits);
+        if (info->nsme_lengths)
+            print_lengths(f, info->sme_lengths, info->nsme_lengths);
+        fprintf(f, "\n");
+    } else {
+        fprintf(f, "SME: no\n");
+    }
+}
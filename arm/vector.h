@@ -0,0 +1,61 @@
+/* SVE and SME vector lengths
+ *
+ * Copyright (c) 2014, 2024 Evgeny Yulyugin.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *   * Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *   * Redistributions in binary form must reproduce the above copyright
+ *     notice, this list of conditions and the following disclaimer in the
+ *     documentation and/or other materials provided with the distribution.
+ *   * The names of its contributors may be used to endorse or promote products
+ *     derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR
+ * ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifndef GGG_VECTOR_H
+#define GGG_VECTOR_H
+
+#include <stdio.h>
+
+#define VECTOR_MAX_LENGTHS 16
+
+typedef struct {
+    int sve;                /* 0 none, 1 SVE, 2 SVE2, 3 SVE2.1 */
+    int sme;                /* 0 none, 1 SME, 2 SME2 */
+    int fa64;               /* full A64 instruction set in streaming mode */
+    unsigned sve_bits;      /* vector length of the calling thread */
+    unsigned sme_bits;      /* streaming vector length */
+    int nsve_lengths;
+    unsigned sve_lengths[VECTOR_MAX_LENGTHS];   /* bits, ascending */
+    int nsme_lengths;
+    unsigned sme_lengths[VECTOR_MAX_LENGTHS];
+} vector_info_t;
+
+/* SVE vector length of the calling thread in bits, 0 without SVE. Reads
+ * it with RDVL, so vector kernels can pick a 128, 256 or 512-bit variant
+ * without a system call. Threads inherit the length, which changes only
+ * through prctl(PR_SVE_SET_VL). */
+unsigned sve_vector_bits(void);
+
+/* Streaming SVE vector length of SME in bits, 0 without SME */
+unsigned sme_vector_bits(void);
+
+/* Versions from ID_AA64PFR0/PFR1, ZFR0 and SMFR0, current lengths and all
+ * lengths the process could switch to, probed in a short-lived thread */
+void vector_info(vector_info_t *info);
+
+void print_vectors(FILE *f, const vector_info_t *info);
+
+#endif /* GGG_VECTOR_H */
@@ -0,0 +1,238 @@
+/* Audit of features hidden from a guest by its virtual CPU model
+ *
+ * Copyright (c) 2014, 2024 Grigory Rechistov and Evgeny Yulyugin.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *   * Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *   * Redistributions in binary form must reproduce the above copyright
+ *     notice, this list of conditions and the following disclaimer in the
+ *     documentation and/or other materials provided with the distribution.
+ *   * The names of its contributors may be used to endorse or promote products
+ *     derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR
+ * ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/* Hypervisors present a CPU model to the guest that is often more
+ * conservative than the host: a named QEMU model or a cloud flavor for the
+ * oldest CPU of a migration pool. The signature and brand string usually
+ * still come from the host, which is enough to look up what the silicon can
+ * do and name the capabilities the guest lost. */
+
+#include <string.h>
+#include <stdio.h>
+#include <stdint.h>
+
+#include "audit.h"
+#include "cpufeatures.h"
+#include "decode.h"
+
+enum {
+    CAP_AVX2 = 1 << 0,
+    CAP_AVX512 = 1 << 1,
+    CAP_AVX512_VNNI = 1 << 2,
+    CAP_AVX512_ICL = 1 << 3,
+    CAP_AVX512_BF16 = 1 << 4,
+    CAP_AVX512_FP16 = 1 << 5,
+    CAP_AMX = 1 << 6,
+    CAP_AVX_VNNI = 1 << 7,
+    CAP_VAES = 1 << 8,
+    CAP_GFNI = 1 << 9,
+    CAP_SHA = 1 << 10,
+    CAP_TSX = 1 << 11,
+    CAP_INVTSC = 1 << 12,
+    CAP_PMU = 1 << 13,
+    CAP_1G_PAGES = 1 << 14,
+};
+
+/* Feature names of every capability in the order of CAP_ bits, "pmu" is
+ * checked separately */
+static const struct {
+    const char *name;
+    const char *features;
+} capabilities[] = {
+    {"AVX2", "avx2 fma bmi1 bmi2 f16c movbe"},
+    {"AVX-512", "avx512f avx512cd avx512bw avx512dq avx512vl"},
+    {"AVX-512 VNNI", "avx512_vnni"},
+    {"AVX-512 Ice Lake extensions",
+     "avx512ifma avx512vbmi avx512_vbmi2 avx512_bitalg avx512_vpopcntdq"},
+    {"AVX-512 BF16", "avx512_bf16"},
+    {"AVX-512 FP16", "avx512_fp16"},
+    {"AMX", "amx_tile amx_int8 amx_bf16"},
+    {"AVX-VNNI", "avx_vnni"},
+    {"VAES", "vaes vpclmulqdq"},
+    {"GFNI", "gfni"},
+    {"SHA", "sha_ni"},
+    {"TSX", "rtm"},
+    {"invariant TSC", "invariant_tsc"},
+    {"PMU", "pmu"},
+    {"1G pages", "pdpe1gb"},
+};
+
+#define NCAPABILITIES (sizeof(capabilities) / sizeof(capabilities[0]))
+
+#define CAP_SERVER (CAP_INVTSC | CAP_PMU | CAP_1G_PAGES)
+#define CAP_HASWELL (CAP_SERVER | CAP_AVX2)
+#define CAP_SKYLAKE_SP (CAP_HASWELL | CAP_AVX512)
+#define CAP_ICELAKE (CAP_SKYLAKE_SP | CAP_AVX512_VNNI | CAP_AVX512_ICL \
+                     | CAP_VAES | CAP_GFNI | CAP_SHA)
+#define CAP_SAPPHIRE_RAPIDS (CAP_ICELAKE | CAP_AVX512_BF16 | CAP_AVX512_FP16 \
+                             | CAP_AMX | CAP_AVX_VNNI)
+#define CAP_GRACEMONT (CAP_HASWELL | CAP_VAES | CAP_GFNI | CAP_SHA | CAP_AVX_VNNI)
+#define CAP_ZEN (CAP_HASWELL | CAP_SHA)
+#define CAP_ZEN4 (CAP_ZEN | CAP_AVX512 | CAP_AVX512_VNNI | CAP_AVX512_ICL \
+                  | CAP_AVX512_BF16 | CAP_VAES | CAP_GFNI)
+
+typedef struct {
+    const char *vendor;
+    uint32_t family;
+    uint32_t model;
+    uint32_t min_stepping;
+    uint32_t max_stepping;
+    const char *brand;          // substring of the brand string or NULL
+    const char *name;
+    uint32_t caps;
+    uint32_t optional_caps;     // often disabled by microcode or firmware
+} cpu_model_t;
+
+#define INTEL "GenuineIntel"
+#define AMD "AuthenticAMD"
+
+/* Entries with a brand come before the generic entry of the same model */
+static const cpu_model_t models[] = {
+    {INTEL, 6, 0x3f, 0, 0xf, NULL, "Haswell", CAP_HASWELL, CAP_TSX},
+    {INTEL, 6, 0x4f, 0, 0xf, NULL, "Broadwell", CAP_HASWELL, CAP_TSX},
+    {INTEL, 6, 0x55, 0, 4, "Core", "Skylake-X", CAP_SKYLAKE_SP, CAP_TSX},
+    {INTEL, 6, 0x55, 0, 4, NULL, "Skylake-SP", CAP_SKYLAKE_SP, CAP_TSX},
+    {INTEL, 6, 0x55, 5, 7, "Core", "Cascade Lake-X",
+     CAP_SKYLAKE_SP | CAP_AVX512_VNNI, CAP_TSX},
+    {INTEL, 6, 0x55, 5, 7, NULL, "Cascade Lake",
+     CAP_SKYLAKE_SP | CAP_AVX512_VNNI, CAP_TSX},
+    {INTEL, 6, 0x55, 10, 11, NULL, "Cooper Lake",
+     CAP_SKYLAKE_SP | CAP_AVX512_VNNI | CAP_AVX512_BF16, CAP_TSX},
+    {INTEL, 6, 0x6a, 0, 0xf, NULL, "Ice Lake-SP", CAP_ICELAKE, CAP_TSX},
+    {INTEL, 6, 0x6c, 0, 0xf, NULL, "Ice Lake-D", CAP_ICELAKE, CAP_TSX},
+    {INTEL, 6, 0x8f, 0, 0xf, NULL, "Sapphire Rapids", CAP_SAPPHIRE_RAPIDS, CAP_TSX},
+    {INTEL, 6, 0xcf, 0, 0xf, NULL, "Emerald Rapids", CAP_SAPPHIRE_RAPIDS, CAP_TSX},
+    {INTEL, 6, 0xad, 0, 0xf, NULL, "Granite Rapids", CAP_SAPPHIRE_RAPIDS, CAP_TSX},
+    {INTEL, 6, 0xaf, 0, 0xf, NULL, "Sierra Forest", CAP_GRACEMONT, 0},
+    {INTEL, 6, 0x8e, 0, 0xf, NULL, "Kaby Lake", CAP_HASWELL, CAP_TSX},
+    {INTEL, 6, 0x9e, 0, 0xf, "Xeon", "Coffee Lake-E", CAP_HASWELL, CAP_TSX},
+    {INTEL, 6, 0x9e, 0, 0xf, NULL, "Coffee Lake", CAP_HASWELL, CAP_TSX},
+    {INTEL, 6, 0x7e, 0, 0xf, NULL, "Ice Lake", CAP_ICELAKE, 0},
+    {INTEL, 6, 0x8c, 0, 0xf, NULL, "Tiger Lake", CAP_ICELAKE, 0},
+    {INTEL, 6, 0x97, 0, 0xf, NULL, "Alder Lake", CAP_GRACEMONT, 0},
+    {INTEL, 6, 0x9a, 0, 0xf, NULL, "Alder Lake", CAP_GRACEMONT, 0},
+    {INTEL, 6, 0xb7, 0, 0xf, NULL, "Raptor Lake", CAP_GRACEMONT, 0},
+    {INTEL, 6, 0xba, 0, 0xf, NULL, "Raptor Lake", CAP_GRACEMONT, 0},
+    {INTEL, 6, 0xbf, 0, 0xf, NULL, "Raptor Lake", CAP_GRACEMONT, 0},
+    {AMD, 0x17, 0x01, 0, 0xf, "EPYC", "Naples", CAP_ZEN, 0},
+    {AMD, 0x17, 0x31, 0, 0xf, "EPYC", "Rome", CAP_ZEN, 0},
+    {AMD, 0x17, 0x31, 0, 0xf, NULL, "Castle Peak", CAP_ZEN, 0},
+    {AMD, 0x19, 0x01, 0, 0xf, NULL, "Milan", CAP_ZEN | CAP_VAES, 0},
+    {AMD, 0x19, 0x11, 0, 0xf, NULL, "Genoa", CAP_ZEN4, 0},
+    {AMD, 0x19, 0xa0, 0, 0xf, NULL, "Bergamo", CAP_ZEN4, 0},
+    {AMD, 0x1a, 0x02, 0, 0xf, NULL, "Turin", CAP_ZEN4 | CAP_AVX_VNNI, 0},
+    {AMD, 0x1a, 0x11, 0, 0xf, NULL, "Turin Dense", CAP_ZEN4 | CAP_AVX_VNNI, 0},
+};
+
+static const cpu_model_t *find_model(const cpuid_snapshot_t *snap) {
+    char vendor[13], brand[49];
+    uint32_t family, model, stepping;
+
+    snapshot_vendor(snap, vendor);
+    snapshot_signature(snap, &family, &model, &stepping);
+    decode_brand(snap, brand);
+
+    for (size_t i = 0; i < sizeof(models) / sizeof(models[0]); ++i) {
+        const cpu_model_t *m = &models[i];
+        if (!strcmp(m->vendor, vendor) && m->family == family
+            && m->model == model && stepping >= m->min_stepping
+            && stepping <= m->max_stepping
+            && (!m->brand || strstr(brand, m->brand)))
+            return m;
+    }
+    return NULL;
+}
+
+/* Intel reports the architectural PMU in leaf 0xa, AMD the core counters
+ * in leaf 0x80000001. Hypervisors without vPMU clear both. */
+static int has_pmu(const cpuid_snapshot_t *snap) {
+    const cpuid_record_t *rec = snapshot_find(snap, 0xa, 0);
+    const cpu_feature_t *perfctr = cpu_feature_by_name("perfctr_core", 12);
+
+    return (rec && (rec->r.eax & 0xff)) || cpu_feature_present(snap, perfctr);
+}
+
+/* Append the names of missing features of a capability to buf */
+static int missing_features(const cpuid_snapshot_t *snap, const char *list,
+                            char *buf, size_t len) {
+    int missing = 0;
+    size_t used = 0;
+
+    buf[0] = '\0';
+    while (*list) {
+        size_t n = strcspn(list, " ");
+        int present;
+        if (n == 3 && !strncmp(list, "pmu", 3)) {
+            present = has_pmu(snap);
+        } else {
+            const cpu_feature_t *feat = cpu_feature_by_name(list, n);
+            present = feat && cpu_feature_present(snap, feat);
+        }
+        if (!present) {
+            missing++;
+            used += snprintf(buf + used, used < len ? len - used : 0,
+                             "%s%.*s", used ? " " : "", (int)n, list);
+        }
+        list += n;
+        list += strspn(list, " ");
+    }
+    return missing;
+}
+
+int audit_masking(FILE *f, const cpuid_snapshot_t *snap) {
+    char vendor[13];
+    uint32_t family, model, stepping;
+    const cpu_model_t *m = find_model(snap);
+
+    snapshot_vendor(snap, vendor);
+    snapshot_signature(snap, &family, &model, &stepping);
+    if (!m) {
+        fprintf(f, "Unknown CPU model: %s family %#x model %#x stepping %u\n",
+                vendor, family, model, stepping);
+        return -1;
+    }
+
+    const cpu_feature_t *hv = cpu_feature_by_name("hypervisor", 10);
+    fprintf(f, "CPU model: %s (%s family %#x model %#x stepping %u)%s\n",
+            m->name, vendor, family, model, stepping,
+            cpu_feature_present(snap, hv) ? ", running under a hypervisor" : "");
+
+    int lost = 0;
+    for (size_t i = 0; i < NCAPABILITIES; ++i) {
+        uint32_t cap = 1u << i;
+        char names[256];
+        if (!((m->caps | m->optional_caps) & cap)
+            || !missing_features(snap, capabilities[i].features, names, sizeof(names)))
+            continue;
+        if (!lost++)
+            fprintf(f, "Lost capabilities:\n");
+        fprintf(f, "  %-28s %s%s\n", capabilities[i].name, names,
+                m->optional_caps & cap ? " (may be disabled by microcode)" : "");
+    }
+    if (!lost)
+        fprintf(f, "No capabilities lost\n");
+    return lost;
+}
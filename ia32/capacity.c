@@ -0,0 +1,253 @@
+/* Parallelism available to a process in a container
+ *
+ * Copyright (c) 2014, 2024 Grigory Rechistov and Evgeny Yulyugin.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *   * Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *   * Redistributions in binary form must reproduce the above copyright
+ *     notice, this list of conditions and the following disclaimer in the
+ *     documentation and/or other materials provided with the distribution.
+ *   * The names of its contributors may be used to endorse or promote products
+ *     derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR
+ * ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/* nproc counts the CPUs of the affinity mask, but a container may get
+ * much less time than that through the CPU bandwidth controller, and SMT
+ * siblings or CPUs of one L3 domain do not scale like separate cores.
+ * Cores and L3 domains are told apart by the x2APIC IDs the CPUs report. */
+
+#include <string.h>
+#include <stdio.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <unistd.h>
+
+#include "capacity.h"
+#include "decode.h"
+
+#define CGROUP_ROOT "/sys/fs/cgroup"
+
+/* Limit in CPUs from cpu.max of cgroup v2, 0 if unlimited, -1 if the file
+ * is missing */
+static double read_quota_v2(const char *dir) {
+    char path[4096], quota[32];
+    unsigned long period;
+
+    snprintf(path, sizeof(path), "%s/cpu.max", dir);
+    FILE *f = fopen(path, "r");
+    if (!f)
+        return -1;
+    int n = fscanf(f, "%31s %lu", quota, &period);
+    fclose(f);
+    if (n != 2 || !strcmp(quota, "max") || period == 0)
+        return 0;
+    return strtod(quota, NULL) / period;
+}
+
+/* The same from cpu.cfs_quota_us and cpu.cfs_period_us of cgroup v1 */
+static double read_quota_v1(const char *dir) {
+    char path[4096];
+    long quota = -1, period = 0;
+
+    snprintf(path, sizeof(path), "%s/cpu.cfs_quota_us", dir);
+    FILE *f = fopen(path, "r");
+    if (!f)
+        return -1;
+    if (fscanf(f, "%ld", &quota) != 1)
+        quota = -1;
+    fclose(f);
+
+    snprintf(path, sizeof(path), "%s/cpu.cfs_period_us", dir);
+    f = fopen(path, "r");
+    if (!f)
+        return -1;
+    if (fscanf(f, "%ld", &period) != 1)
+        period = 0;
+    fclose(f);
+    return quota > 0 && period > 0 ? (double)quota / period : 0;
+}
+
+/* Directory of the cgroup under root. Inside a container /proc/self/cgroup
+ * often shows the path of the host while the container's own cgroup is
+ * mounted at root, so leading components are dropped until the rest
+ * exists, down to root itself. */
+static void resolve_cgroup(const char *root, const char *cgroup,
+                           char *dir, size_t len) {
+    while (*cgroup) {
+        snprintf(dir, len, "%s%s", root, cgroup);
+        if (access(dir, F_OK) == 0)
+            return;
+        const char *next = strchr(cgroup + 1, '/');
+        cgroup = next ? next : "";
+    }
+    snprintf(dir, len, "%s", root);
+}
+
+/* Smallest limit of the cgroup and its ancestors below root. A child
+ * cannot get more than its parents allow. */
+static double walk_quota(const char *root, const char *cgroup,
+                         double (*read_quota)(const char *),
+                         char *source, size_t len) {
+    char dir[4096];
+    double best = 0;
+    int found = 0;
+
+    resolve_cgroup(root, cgroup, dir, sizeof(dir));
+    size_t root_len = strlen(root);
+    while (strlen(dir) >= root_len) {
+        double q = read_quota(dir);
+        if (q >= 0)
+            found = 1;
+        if (q > 0 && (best == 0 || q < best)) {
+            best = q;
+            snprintf(source, len, "%s", dir);
+        }
+        char *slash = strrchr(dir + root_len, '/');
+        if (!slash)
+            break;
+        *slash = '\0';
+    }
+    return found ? best : -1;
+}
+
+/* Whether a comma separated list of cgroup v1 controllers has this one */
+static int has_controller(const char *list, const char *name) {
+    size_t len = strlen(name);
+
+    while (*list) {
+        size_t n = strcspn(list, ",");
+        if (n == len && !strncmp(list, name, len))
+            return 1;
+        list += n;
+        if (*list == ',')
+            list++;
+    }
+    return 0;
+}
+
+double cgroup_cpu_quota(char *source, size_t len) {
+    FILE *f = fopen("/proc/self/cgroup", "r");
+    char *line = NULL;
+    size_t cap = 0;
+    double quota = -1;
+
+    source[0] = '\0';
+    if (!f)
+        return 0;
+    while (quota < 0 && getline(&line, &cap, f) >= 0) {
+        line[strcspn(line, "\n")] = '\0';
+        // hierarchy-ID:controllers:path, v2 has ID 0 and no controllers
+        char *controllers = strchr(line, ':');
+        char *path = controllers ? strchr(controllers + 1, ':') : NULL;
+        if (!path)
+            continue;
+        *path++ = '\0';
+        controllers++;
+
+        if (!strcmp(line, "0") && !*controllers) {
+            quota = walk_quota(CGROUP_ROOT, path, read_quota_v2, source, len);
+        } else if (has_controller(controllers, "cpu")) {
+            quota = walk_quota(CGROUP_ROOT "/cpu", path, read_quota_v1, source, len);
+        }
+    }
+    fclose(f);
+    free(line);
+    return quota > 0 ? quota : 0;
+}
+
+static int cmp_u32(const void *a, const void *b) {
+    uint32_t x = *(const uint32_t *)a, y = *(const uint32_t *)b;
+    return x < y ? -1 : x > y;
+}
+
+static int count_distinct(uint32_t *ids, int n) {
+    int distinct = 0;
+
+    qsort(ids, n, sizeof(ids[0]), cmp_u32);
+    for (int i = 0; i < n; ++i)
+        if (i == 0 || ids[i] != ids[i - 1])
+            distinct++;
+    return distinct;
+}
+
+/* CPU numbers as ranges, e.g. "0-3,8-11" */
+static void print_cpu_list(FILE *f, const int *cpus, int n) {
+    for (int i = 0; i < n; ) {
+        int j = i;
+        while (j + 1 < n && cpus[j + 1] == cpus[j] + 1)
+            j++;
+        fprintf(f, "%s%d", i ? "," : "", cpus[i]);
+        if (j > i)
+            fprintf(f, "-%d", cpus[j]);
+        i = j + 1;
+    }
+}
+
+void print_capacity(FILE *f, const int *cpus, const cpuid_snapshot_t *snaps,
+                    int n) {
+    uint32_t *cores = malloc(n * sizeof(uint32_t));
+    uint32_t *l3s = malloc(n * sizeof(uint32_t));
+    int nl3 = 0;
+
+    if (!cores || !l3s) {
+        free(cores);
+        free(l3s);
+        fprintf(stderr, "Out of memory\n");
+        return;
+    }
+
+    for (int i = 0; i < n; ++i) {
+        topology_t topo;
+        cache_info_t caches[16];
+        decode_topology(&snaps[i], &topo);
+        cores[i] = topo.x2apic_id >> topo.smt_shift;
+
+        int ncaches = decode_caches(&snaps[i], caches, 16);
+        const cache_info_t *l3 = find_cache(caches, ncaches, 3, CACHE_UNIFIED);
+        if (l3)
+            l3s[nl3++] = topo.x2apic_id >> bits_for(l3->sharing);
+    }
+
+    char source[4096];
+    double quota = cgroup_cpu_quota(source, sizeof(source));
+    int ncores = count_distinct(cores, n);
+    int parallelism = n;
+    if (quota > 0 && quota < parallelism) {
+        parallelism = (int)quota;
+        if (parallelism < quota)
+            parallelism++;
+    }
+
+    fprintf(f, "Allowed CPUs:          %d (", n);
+    print_cpu_list(f, cpus, n);
+    fprintf(f, ")\n");
+    if (quota > 0)
+        fprintf(f, "CPU quota:             %.2f (%s)\n", quota, source);
+    else
+        fprintf(f, "CPU quota:             none\n");
+    fprintf(f, "Physical cores:        %d\n", ncores);
+    if (nl3)
+        fprintf(f, "L3 domains:            %d\n", count_distinct(l3s, nl3));
+    else
+        fprintf(f, "L3 domains:            unknown\n");
+    fprintf(f, "Effective parallelism: %d", parallelism);
+    if (parallelism > ncores)
+        fprintf(f, " (%d on separate cores)", ncores);
+    fprintf(f, "\n");
+
+    free(cores);
+    free(l3s);
+}
@@ -0,0 +1,45 @@
+/* Parallelism available to a process in a container
+ *
+ * Copyright (c) 2014, 2024 Grigory Rechistov and Evgeny Yulyugin.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *   * Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *   * Redistributions in binary form must reproduce the above copyright
+ *     notice, this list of conditions and the following disclaimer in the
+ *     documentation and/or other materials provided with the distribution.
+ *   * The names of its contributors may be used to endorse or promote products
+ *     derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR
+ * ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifndef GGG_CAPACITY_H
+#define GGG_CAPACITY_H
+
+#include <stdio.h>
+#include <stddef.h>
+
+#include "snapshot.h"
+
+/* CPU bandwidth limit of the cgroup of this process in CPUs, 0 if there is
+ * none. The file the limit was read from is stored in source. */
+double cgroup_cpu_quota(char *source, size_t len);
+
+/* Print allowed CPUs, cgroup quota, physical cores and L3 domains covered
+ * by the CPUs and the resulting parallelism. snaps[i] is the snapshot
+ * taken on CPU cpus[i]. */
+void print_capacity(FILE *f, const int *cpus, const cpuid_snapshot_t *snaps,
+                    int n);
+
+#endif /* GGG_CAPACITY_H */
@@ -0,0 +1,257 @@
+/* Named CPUID feature bits
+ *
+ * Copyright (c) 2014, 2024 Grigory Rechistov and Evgeny Yulyugin.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *   * Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *   * Redistributions in binary form must reproduce the above copyright
+ *     notice, this list of conditions and the following disclaimer in the
+ *     documentation and/or other materials provided with the distribution.
+ *   * The names of its contributors may be used to endorse or promote products
+ *     derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR
+ * ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include <string.h>
+#include <stdint.h>
+
+#include "cpufeatures.h"
+
+#define F(name, leaf, subleaf, reg, bit) \
+    {name, leaf, subleaf, REG_##reg, bit, 0}
+#define H(name, leaf, subleaf, reg, bit) \
+    {name, leaf, subleaf, REG_##reg, bit, FEATURE_NO_CPUINFO}
+#define X(name, leaf, subleaf, reg, bit, flags) \
+    {name, leaf, subleaf, REG_##reg, bit, flags}
+
+const cpu_feature_t cpu_features[] = {
+    F("fpu",                0x1, 0, EDX, 0),
+    F("vme",                0x1, 0, EDX, 1),
+    F("de",                 0x1, 0, EDX, 2),
+    F("pse",                0x1, 0, EDX, 3),
+    F("tsc",                0x1, 0, EDX, 4),
+    F("msr",                0x1, 0, EDX, 5),
+    F("pae",                0x1, 0, EDX, 6),
+    F("mce",                0x1, 0, EDX, 7),
+    F("cx8",                0x1, 0, EDX, 8),
+    F("apic",               0x1, 0, EDX, 9),
+    F("sep",                0x1, 0, EDX, 11),
+    F("mtrr",               0x1, 0, EDX, 12),
+    F("pge",                0x1, 0, EDX, 13),
+    F("mca",                0x1, 0, EDX, 14),
+    F("cmov",               0x1, 0, EDX, 15),
+    F("pat",                0x1, 0, EDX, 16),
+    F("pse36",              0x1, 0, EDX, 17),
+    F("clflush",            0x1, 0, EDX, 19),
+    F("dts",                0x1, 0, EDX, 21),
+    F("acpi",               0x1, 0, EDX, 22),
+    F("mmx",                0x1, 0, EDX, 23),
+    F("fxsr",               0x1, 0, EDX, 24),
+    F("sse",                0x1, 0, EDX, 25),
+    F("sse2",               0x1, 0, EDX, 26),
+    F("ss",                 0x1, 0, EDX, 27),
+    F("ht",                 0x1, 0, EDX, 28),
+    F("tm",                 0x1, 0, EDX, 29),
+    F("pbe",                0x1, 0, EDX, 31),
+
+    F("pni",                0x1, 0, ECX, 0),
+    X("pclmulqdq",          0x1, 0, ECX, 1, FEATURE_HOT),
+    F("dtes64",             0x1, 0, ECX, 2),
+    F("monitor",            0x1, 0, ECX, 3),
+    F("ds_cpl",             0x1, 0, ECX, 4),
+    F("vmx",                0x1, 0, ECX, 5),
+    F("smx",                0x1, 0, ECX, 6),
+    F("est",                0x1, 0, ECX, 7),
+    F("tm2",                0x1, 0, ECX, 8),
+    F("ssse3",              0x1, 0, ECX, 9),
+    F("cid",                0x1, 0, ECX, 10),
+    F("sdbg",               0x1, 0, ECX, 11),
+    X("fma",                0x1, 0, ECX, 12, FEATURE_HOT),
+    F("cx16",               0x1, 0, ECX, 13),
+    F("xtpr",               0x1, 0, ECX, 14),
+    F("pdcm",               0x1, 0, ECX, 15),
+    X("pcid",               0x1, 0, ECX, 17, FEATURE_HOT),
+    F("dca",                0x1, 0, ECX, 18),
+    F("sse4_1",             0x1, 0, ECX, 19),
+    X("sse4_2",             0x1, 0, ECX, 20, FEATURE_HOT),
+    X("x2apic",             0x1, 0, ECX, 21, FEATURE_HOT),
+    X("movbe",              0x1, 0, ECX, 22, FEATURE_HOT),
+    X("popcnt",             0x1, 0, ECX, 23, FEATURE_HOT),
+    X("tsc_deadline_timer", 0x1, 0, ECX, 24, FEATURE_HOT),
+    X("aes",                0x1, 0, ECX, 25, FEATURE_HOT),
+    F("xsave",              0x1, 0, ECX, 26),
+    H("osxsave",            0x1, 0, ECX, 27),
+    X("avx",                0x1, 0, ECX, 28, FEATURE_HOT),
+    X("f16c",               0x1, 0, ECX, 29, FEATURE_HOT),
+    F("rdrand",             0x1, 0, ECX, 30),
+    F("hypervisor",         0x1, 0, ECX, 31),
+
+    F("dtherm",             0x6, 0, EAX, 0),
+    F("ida",                0x6, 0, EAX, 1),
+    F("arat",               0x6, 0, EAX, 2),
+    F("pln",                0x6, 0, EAX, 4),
+    F("pts",                0x6, 0, EAX, 6),
+    F("hwp",                0x6, 0, EAX, 7),
+
+    F("fsgsbase",           0x7, 0, EBX, 0),
+    F("tsc_adjust",         0x7, 0, EBX, 1),
+    F("sgx",                0x7, 0, EBX, 2),
+    X("bmi1",               0x7, 0, EBX, 3, FEATURE_HOT),
+    X("hle",                0x7, 0, EBX, 4, FEATURE_HOT),
+    X("avx2",               0x7, 0, EBX, 5, FEATURE_HOT),
+    F("smep",               0x7, 0, EBX, 7),
+    X("bmi2",               0x7, 0, EBX, 8, FEATURE_HOT),
+    X("erms",               0x7, 0, EBX, 9, FEATURE_HOT),
+    X("invpcid",            0x7, 0, EBX, 10, FEATURE_HOT),
+    X("rtm",                0x7, 0, EBX, 11, FEATURE_HOT),
+    F("cqm",                0x7, 0, EBX, 12),
+    // Dropped from /proc/cpuinfo with the kernel MPX support in Linux 5.6
+    H("mpx",                0x7, 0, EBX, 14),
+    F("rdt_a",              0x7, 0, EBX, 15),
+    X("avx512f",            0x7, 0, EBX, 16, FEATURE_HOT),
+    X("avx512dq",           0x7, 0, EBX, 17, FEATURE_HOT),
+    F("rdseed",             0x7, 0, EBX, 18),
+    X("adx",                0x7, 0, EBX, 19, FEATURE_HOT),
+    F("smap",               0x7, 0, EBX, 20),
+    X("avx512ifma",         0x7, 0, EBX, 21, FEATURE_HOT),
+    X("clflushopt",         0x7, 0, EBX, 23, FEATURE_HOT),
+    X("clwb",               0x7, 0, EBX, 24, FEATURE_HOT),
+    F("intel_pt",           0x7, 0, EBX, 25),
+    F("avx512pf",           0x7, 0, EBX, 26),
+    F("avx512er",           0x7, 0, EBX, 27),
+    X("avx512cd",           0x7, 0, EBX, 28, FEATURE_HOT),
+    X("sha_ni",             0x7, 0, EBX, 29, FEATURE_HOT),
+    X("avx512bw",           0x7, 0, EBX, 30, FEATURE_HOT),
+    X("avx512vl",           0x7, 0, EBX, 31, FEATURE_HOT),
+
+    X("avx512vbmi",         0x7, 0, ECX, 1, FEATURE_HOT),
+    F("umip",               0x7, 0, ECX, 2),
+    F("pku",                0x7, 0, ECX, 3),
+    F("ospke",              0x7, 0, ECX, 4),
+    X("waitpkg",            0x7, 0, ECX, 5, FEATURE_HOT),
+    X("avx512_vbmi2",       0x7, 0, ECX, 6, FEATURE_HOT),
+    X("gfni",               0x7, 0, ECX, 8, FEATURE_HOT),
+    X("vaes",               0x7, 0, ECX, 9, FEATURE_HOT),
+    X("vpclmulqdq",         0x7, 0, ECX, 10, FEATURE_HOT),
+    X("avx512_vnni",        0x7, 0, ECX, 11, FEATURE_HOT),
+    X("avx512_bitalg",      0x7, 0, ECX, 12, FEATURE_HOT),
+    F("tme",                0x7, 0, ECX, 13),
+    X("avx512_vpopcntdq",   0x7, 0, ECX, 14, FEATURE_HOT),
+    F("la57",               0x7, 0, ECX, 16),
+    F("rdpid",              0x7, 0, ECX, 22),
+    F("bus_lock_detect",    0x7, 0, ECX, 24),
+    F("cldemote",           0x7, 0, ECX, 25),
+    X("movdiri",            0x7, 0, ECX, 27, FEATURE_HOT),
+    X("movdir64b",          0x7, 0, ECX, 28, FEATURE_HOT),
+    F("enqcmd",             0x7, 0, ECX, 29),
+    F("sgx_lc",             0x7, 0, ECX, 30),
+
+    F("avx512_4vnniw",      0x7, 0, EDX, 2),
+    F("avx512_4fmaps",      0x7, 0, EDX, 3),
+    X("fsrm",               0x7, 0, EDX, 4, FEATURE_HOT),
+    F("avx512_vp2intersect", 0x7, 0, EDX, 8),
+    X("md_clear",           0x7, 0, EDX, 10, FEATURE_MITIGATION),
+    X("serialize",          0x7, 0, EDX, 14, FEATURE_HOT),
+    F("hybrid_cpu",         0x7, 0, EDX, 15),
+    F("tsxldtrk",           0x7, 0, EDX, 16),
+    F("pconfig",            0x7, 0, EDX, 18),
+    F("arch_lbr",           0x7, 0, EDX, 19),
+    F("ibt",                0x7, 0, EDX, 20),
+    X("amx_bf16",           0x7, 0, EDX, 22, FEATURE_HOT),
+    X("avx512_fp16",        0x7, 0, EDX, 23, FEATURE_HOT),
+    X("amx_tile",           0x7, 0, EDX, 24, FEATURE_HOT),
+    X("amx_int8",           0x7, 0, EDX, 25, FEATURE_HOT),
+    X("spec_ctrl",          0x7, 0, EDX, 26, FEATURE_NO_CPUINFO | FEATURE_MITIGATION),
+    X("intel_stibp",        0x7, 0, EDX, 27, FEATURE_NO_CPUINFO | FEATURE_MITIGATION),
+    X("flush_l1d",          0x7, 0, EDX, 28, FEATURE_MITIGATION),
+    X("arch_capabilities",  0x7, 0, EDX, 29, FEATURE_MITIGATION),
+    X("spec_ctrl_ssbd",     0x7, 0, EDX, 31, FEATURE_NO_CPUINFO | FEATURE_MITIGATION),
+
+    X("avx_vnni",           0x7, 1, EAX, 4, FEATURE_HOT),
+    X("avx512_bf16",        0x7, 1, EAX, 5, FEATURE_HOT),
+    X("cmpccxadd",          0x7, 1, EAX, 7, FEATURE_NO_CPUINFO | FEATURE_HOT),
+    X("amx_fp16",           0x7, 1, EAX, 21, FEATURE_NO_CPUINFO | FEATURE_HOT),
+    X("avx_ifma",           0x7, 1, EAX, 23, FEATURE_NO_CPUINFO | FEATURE_HOT),
+    F("lam",                0x7, 1, EAX, 26),
+
+    F("xsaveopt",           0xd, 1, EAX, 0),
+    F("xsavec",             0xd, 1, EAX, 1),
+    F("xgetbv1",            0xd, 1, EAX, 2),
+    F("xsaves",             0xd, 1, EAX, 3),
+    H("xfd",                0xd, 1, EAX, 4),
+
+    F("lahf_lm",            0x80000001, 0, ECX, 0),
+    F("cmp_legacy",         0x80000001, 0, ECX, 1),
+    F("svm",                0x80000001, 0, ECX, 2),
+    F("extapic",            0x80000001, 0, ECX, 3),
+    F("cr8_legacy",         0x80000001, 0, ECX, 4),
+    F("abm",                0x80000001, 0, ECX, 5),
+    F("sse4a",              0x80000001, 0, ECX, 6),
+    F("misalignsse",        0x80000001, 0, ECX, 7),
+    F("3dnowprefetch",      0x80000001, 0, ECX, 8),
+    F("osvw",               0x80000001, 0, ECX, 9),
+    F("ibs",                0x80000001, 0, ECX, 10),
+    F("xop",                0x80000001, 0, ECX, 11),
+    F("skinit",             0x80000001, 0, ECX, 12),
+    F("wdt",                0x80000001, 0, ECX, 13),
+    F("lwp",                0x80000001, 0, ECX, 15),
+    F("fma4",               0x80000001, 0, ECX, 16),
+    F("tce",                0x80000001, 0, ECX, 17),
+    F("nodeid_msr",         0x80000001, 0, ECX, 19),
+    F("tbm",                0x80000001, 0, ECX, 21),
+    F("topoext",            0x80000001, 0, ECX, 22),
+    F("perfctr_core",       0x80000001, 0, ECX, 23),
+    F("perfctr_nb",         0x80000001, 0, ECX, 24),
+    F("bpext",              0x80000001, 0, ECX, 26),
+    F("perfctr_llc",        0x80000001, 0, ECX, 28),
+    F("mwaitx",             0x80000001, 0, ECX, 29),
+
+    F("syscall",            0x80000001, 0, EDX, 11),
+    F("mp",                 0x80000001, 0, EDX, 19),
+    F("nx",                 0x80000001, 0, EDX, 20),
+    F("mmxext",             0x80000001, 0, EDX, 22),
+    F("fxsr_opt",           0x80000001, 0, EDX, 25),
+    X("pdpe1gb",            0x80000001, 0, EDX, 26, FEATURE_HOT),
+    X("rdtscp",             0x80000001, 0, EDX, 27, FEATURE_HOT),
+    F("lm",                 0x80000001, 0, EDX, 29),
+    F("3dnowext",           0x80000001, 0, EDX, 30),
+    F("3dnow",              0x80000001, 0, EDX, 31),
+
+    X("invariant_tsc",      0x80000007, 0, EDX, 8, FEATURE_NO_CPUINFO | FEATURE_HOT),
+
+    F("clzero",             0x80000008, 0, EBX, 0),
+    F("irperf",             0x80000008, 0, EBX, 1),
+    F("xsaveerptr",         0x80000008, 0, EBX, 2),
+    F("rdpru",              0x80000008, 0, EBX, 4),
+    F("wbnoinvd",           0x80000008, 0, EBX, 9),
+};
+
+const size_t cpu_features_count = sizeof(cpu_features) / sizeof(cpu_features[0]);
+
+const cpu_feature_t *cpu_feature_by_name(const char *name, size_t len) {
+    for (size_t i = 0; i < cpu_features_count; ++i) {
+        const char *n = cpu_features[i].name;
+        if (!strncmp(n, name, len) && n[len] == '\0')
+            return &cpu_features[i];
+    }
+    return NULL;
+}
+
+int cpu_feature_present(const cpuid_snapshot_t *snap, const cpu_feature_t *f) {
+    const cpuid_record_t *rec = snapshot_find(snap, f->leaf, f->subleaf);
+    if (!rec)
+        return 0;
+    return (cpuid_reg(&rec->r, f->reg) >> f->bit) & 1;
+}
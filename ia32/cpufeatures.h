@@ -0,0 +1,58 @@
+/* Named CPUID feature bits
+ *
+ * Copyright (c) 2014, 2024 Grigory Rechistov and Evgeny Yulyugin.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *   * Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *   * Redistributions in binary form must reproduce the above copyright
+ *     notice, this list of conditions and the following disclaimer in the
+ *     documentation and/or other materials provided with the distribution.
+ *   * The names of its contributors may be used to endorse or promote products
+ *     derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR
+ * ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifndef GGG_CPUFEATURES_H
+#define GGG_CPUFEATURES_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "snapshot.h"
+
+/* Linux does not show the bit in /proc/cpuinfo under this name */
+#define FEATURE_NO_CPUINFO 0x1
+/* Instruction set or platform feature that hot code paths depend on */
+#define FEATURE_HOT 0x2
+/* Speculative execution mitigation control */
+#define FEATURE_MITIGATION 0x4
+
+typedef struct {
+    const char *name;   /* as in /proc/cpuinfo */
+    uint32_t leaf;
+    uint32_t subleaf;
+    uint8_t reg;
+    uint8_t bit;
+    uint8_t flags;
+} cpu_feature_t;
+
+extern const cpu_feature_t cpu_features[];
+extern const size_t cpu_features_count;
+
+const cpu_feature_t *cpu_feature_by_name(const char *name, size_t len);
+
+int cpu_feature_present(const cpuid_snapshot_t *snap, const cpu_feature_t *f);
+
+#endif /* GGG_CPUFEATURES_H */
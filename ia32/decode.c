@@ -0,0 +1,229 @@
+/* Decoding of cache, topology and identification leaves
+ *
+ * Copyright (c) 2014, 2024 Grigory Rechistov and Evgeny Yulyugin.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *   * Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *   * Redistributions in binary form must reproduce the above copyright
+ *     notice, this list of conditions and the following disclaimer in the
+ *     documentation and/or other materials provided with the distribution.
+ *   * The names of its contributors may be used to endorse or promote products
+ *     derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR
+ * ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include <string.h>
+#include <stdint.h>
+
+#include "decode.h"
+
+uint32_t bits_for(uint32_t n) {
+    uint32_t bits = 0;
+    while (n > (1u << bits) && bits < 32)
+        bits++;
+    return bits;
+}
+
+static int is_amd(const cpuid_snapshot_t *snap) {
+    char vendor[13];
+    snapshot_vendor(snap, vendor);
+    return !strcmp(vendor, "AuthenticAMD") || !strcmp(vendor, "HygonGenuine");
+}
+
+static uint32_t cache_leaf(const cpuid_snapshot_t *snap) {
+    if (is_amd(snap) && snapshot_find(snap, 0x8000001d, 0))
+        return 0x8000001d;
+    return 0x4;
+}
+
+static uint32_t topology_leaf(const cpuid_snapshot_t *snap) {
+    return snapshot_find(snap, 0x1f, 0) ? 0x1f : 0xb;
+}
+
+/* Number of levels in leaf 0xb or 0x1f, 0 if the leaf is not enumerated */
+static uint32_t topology_levels(const cpuid_snapshot_t *snap) {
+    uint32_t leaf = topology_leaf(snap), n = 0;
+    const cpuid_record_t *rec;
+
+    while ((rec = snapshot_find(snap, leaf, n)) && ((rec->r.ecx >> 8) & 0xff))
+        n++;
+    return n;
+}
+
+int decode_caches(const cpuid_snapshot_t *snap, cache_info_t *caches, int max) {
+    uint32_t leaf = cache_leaf(snap);
+    int n = 0;
+
+    for (uint32_t subleaf = 0; n < max; ++subleaf) {
+        const cpuid_record_t *rec = snapshot_find(snap, leaf, subleaf);
+        // EAX[4:0] of zero: no more caches
+        if (!rec || (rec->r.eax & 0x1f) == 0)
+            break;
+
+        cache_info_t *c = &caches[n++];
+        c->type = rec->r.eax & 0x1f;
+        c->level = (rec->r.eax >> 5) & 0x7;
+        c->sharing = ((rec->r.eax >> 14) & 0xfff) + 1;
+        c->line_size = (rec->r.ebx & 0xfff) + 1;
+        c->partitions = ((rec->r.ebx >> 12) & 0x3ff) + 1;
+        c->ways = ((rec->r.ebx >> 22) & 0x3ff) + 1;
+        c->sets = rec->r.ecx + 1;
+        c->size = c->ways * c->partitions * c->line_size * c->sets;
+    }
+    return n;
+}
+
+const cache_info_t *find_cache(const cache_info_t *caches, int n,
+                               uint32_t level, uint32_t type) {
+    const cache_info_t *best = NULL;
+    for (int i = 0; i < n; ++i) {
+        const cache_info_t *c = &caches[i];
+        if (c->level != level)
+            continue;
+        if (c->type != type && !(type == CACHE_DATA && c->type == CACHE_UNIFIED))
+            continue;
+        if (!best || c->size > best->size)
+            best = c;
+    }
+    return best;
+}
+
+void decode_topology(const cpuid_snapshot_t *snap, topology_t *topo) {
+    const cpuid_record_t *leaf1 = snapshot_find(snap, 1, 0);
+    uint32_t topo_leaf = topology_leaf(snap);
+
+    memset(topo, 0, sizeof(*topo));
+    topo->threads_per_core = 1;
+    topo->logical_per_package = 1;
+    if (leaf1) {
+        topo->x2apic_id = leaf1->r.ebx >> 24;
+        // HTT: EBX[23:16] is the number of addressable IDs per package
+        if (leaf1->r.edx & (1u << 28))
+            topo->logical_per_package = (leaf1->r.ebx >> 16) & 0xff;
+    }
+
+    const cpuid_record_t *rec = snapshot_find(snap, topo_leaf, 0);
+    if (rec && ((rec->r.ecx >> 8) & 0xff) != 0) {
+        // Levels go from SMT up, the last valid one is below the package
+        for (uint32_t subleaf = 0; rec && ((rec->r.ecx >> 8) & 0xff);
+             rec = snapshot_find(snap, topo_leaf, ++subleaf)) {
+            uint32_t type = (rec->r.ecx >> 8) & 0xff;
+            if (type == 1) {
+                topo->smt_shift = rec->r.eax & 0x1f;
+                topo->threads_per_core = rec->r.ebx & 0xffff;
+            }
+            topo->package_shift = rec->r.eax & 0x1f;
+            topo->logical_per_package = rec->r.ebx & 0xffff;
+            topo->x2apic_id = rec->r.edx;
+        }
+    } else if (is_amd(snap)) {
+        const cpuid_record_t *ext1e = snapshot_find(snap, 0x8000001e, 0);
+        const cpuid_record_t *ext8 = snapshot_find(snap, 0x80000008, 0);
+        if (ext1e)
+            topo->threads_per_core = ((ext1e->r.ebx >> 8) & 0xff) + 1;
+        if (ext8) {
+            // ApicIdSize, or the legacy NC field when it is zero
+            topo->package_shift = (ext8->r.ecx >> 12) & 0xf;
+            topo->logical_per_package = (ext8->r.ecx & 0xff) + 1;
+            if (!topo->package_shift)
+                topo->package_shift = bits_for(topo->logical_per_package);
+        }
+        topo->smt_shift = bits_for(topo->threads_per_core);
+    } else {
+        const cpuid_record_t *leaf4 = snapshot_find(snap, 0x4, 0);
+        uint32_t cores = leaf4 ? ((leaf4->r.eax >> 26) & 0x3f) + 1 : 1;
+        if (topo->logical_per_package > cores)
+            topo->threads_per_core = topo->logical_per_package / cores;
+        topo->smt_shift = bits_for(topo->threads_per_core);
+        topo->package_shift = bits_for(topo->logical_per_package);
+    }
+
+    if (!topo->threads_per_core)
+        topo->threads_per_core = 1;
+    if (!topo->logical_per_package)
+        topo->logical_per_package = topo->threads_per_core;
+}
+
+uint32_t decode_field_bits(const cpuid_snapshot_t *snap, uint32_t leaf,
+                           uint32_t subleaf, int reg) {
+    const cpuid_record_t *leaf1 = snapshot_find(snap, 1, 0);
+    const cpuid_record_t *rec;
+    uint32_t mask = 0;
+
+    if (leaf == cache_leaf(snap)) {
+        uint32_t n = 0;
+        while ((rec = snapshot_find(snap, leaf, n)) && (rec->r.eax & 0x1f))
+            n++;
+        // The type of the entry after the last cache ends the list
+        if (subleaf <= n && reg == REG_EAX)
+            mask |= 0x1f;
+        if (subleaf < n) {
+            if (reg == REG_EAX)
+                mask |= 0x03ffc0e0;
+            if (reg == REG_EBX || reg == REG_ECX)
+                mask |= 0xffffffff;
+        }
+    }
+
+    uint32_t levels = topology_levels(snap);
+    int htt = leaf1 && (leaf1->r.edx & (1u << 28));
+    if (leaf == topology_leaf(snap) && subleaf <= levels) {
+        if (reg == REG_ECX)
+            mask |= 0xff00;
+        rec = snapshot_find(snap, leaf, subleaf);
+        // Only the SMT level and the last one below the package are kept
+        if (subleaf < levels && (subleaf + 1 == levels
+                                 || ((rec->r.ecx >> 8) & 0xff) == 1)) {
+            if (reg == REG_EAX)
+                mask |= 0x1f;
+            if (reg == REG_EBX)
+                mask |= 0xffff;
+        }
+        if (subleaf + 1 == levels && reg == REG_EDX)
+            mask |= 0xffffffff;
+    }
+    // Without a topology leaf the x2APIC ID and the package size come
+    // from leaf 1 and the vendor specific leaves
+    if (!levels && is_amd(snap)) {
+        int ext8 = snapshot_find(snap, 0x80000008, 0) != NULL;
+        if (leaf == 0x1 && subleaf == 0 && reg == REG_EBX)
+            mask |= 0xff000000 | (htt && !ext8 ? 0x00ff0000 : 0);
+        if (leaf == 0x8000001e && subleaf == 0 && reg == REG_EBX)
+            mask |= 0xff00;
+        if (leaf == 0x80000008 && subleaf == 0 && reg == REG_ECX)
+            mask |= 0xf0ff;
+    } else if (!levels) {
+        if (leaf == 0x1 && subleaf == 0 && reg == REG_EBX)
+            mask |= 0xff000000 | (htt ? 0x00ff0000 : 0);
+        if (leaf == 0x4 && subleaf == 0 && reg == REG_EAX)
+            mask |= 0xfc000000;
+    }
+    return mask;
+}
+
+void decode_brand(const cpuid_snapshot_t *snap, char *buf) {
+    memset(buf, 0, 49);
+    for (uint32_t i = 0; i < 3; ++i) {
+        const cpuid_record_t *rec = snapshot_find(snap, 0x80000002 + i, 0);
+        if (rec)
+            memcpy(buf + 16 * i, &rec->r, 16);
+    }
+
+    size_t start = strspn(buf, " ");
+    memmove(buf, buf + start, 49 - start);
+    size_t len = strlen(buf);
+    while (len && buf[len - 1] == ' ')
+        buf[--len] = '\0';
+}
@@ -0,0 +1,83 @@
+/* Decoding of cache, topology and identification leaves
+ *
+ * Copyright (c) 2014, 2024 Grigory Rechistov and Evgeny Yulyugin.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *   * Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *   * Redistributions in binary form must reproduce the above copyright
+ *     notice, this list of conditions and the following disclaimer in the
+ *     documentation and/or other materials provided with the distribution.
+ *   * The names of its contributors may be used to endorse or promote products
+ *     derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR
+ * ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifndef GGG_DECODE_H
+#define GGG_DECODE_H
+
+#include <stdint.h>
+
+#include "snapshot.h"
+
+enum {
+    CACHE_DATA = 1,
+    CACHE_INSTRUCTION = 2,
+    CACHE_UNIFIED = 3,
+};
+
+typedef struct {
+    uint32_t level;
+    uint32_t type;
+    uint32_t size;          /* bytes */
+    uint32_t ways;
+    uint32_t partitions;
+    uint32_t line_size;
+    uint32_t sets;
+    uint32_t sharing;       /* maximal number of logical CPUs sharing it */
+} cache_info_t;
+
+typedef struct {
+    uint32_t x2apic_id;
+    uint32_t smt_shift;     /* x2APIC ID bits below the core level */
+    uint32_t package_shift; /* x2APIC ID bits below the package level */
+    uint32_t threads_per_core;
+    uint32_t logical_per_package;
+} topology_t;
+
+/* Deterministic cache parameters from leaf 4 or, on AMD, 0x8000001d.
+ * Returns the number of caches stored. */
+int decode_caches(const cpuid_snapshot_t *snap, cache_info_t *caches, int max);
+
+/* Largest cache of a level and a type (CACHE_DATA also matches unified
+ * caches), NULL if there is none */
+const cache_info_t *find_cache(const cache_info_t *caches, int n,
+                               uint32_t level, uint32_t type);
+
+void decode_topology(const cpuid_snapshot_t *snap, topology_t *topo);
+
+/* Bits of a register that decode_caches() and decode_topology() read from
+ * this snapshot. Reserved and flag bits next to the decoded fields are not
+ * included. */
+uint32_t decode_field_bits(const cpuid_snapshot_t *snap, uint32_t leaf,
+                           uint32_t subleaf, int reg);
+
+/* Brand string from leaves 0x80000002-0x80000004 without padding spaces.
+ * buf must hold 49 bytes. */
+void decode_brand(const cpuid_snapshot_t *snap, char *buf);
+
+/* Number of bits needed to enumerate n values */
+uint32_t bits_for(uint32_t n);
+
+#endif /* GGG_DECODE_H */
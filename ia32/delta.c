@@ -0,0 +1,279 @@
+/* Delta encoding of CPUID snapshots against a reference snapshot
+ *
+ * Copyright (c) 2014, 2024 Grigory Rechistov and Evgeny Yulyugin.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *   * Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *   * Redistributions in binary form must reproduce the above copyright
+ *     notice, this list of conditions and the following disclaimer in the
+ *     documentation and/or other materials provided with the distribution.
+ *   * The names of its contributors may be used to endorse or promote products
+ *     derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR
+ * ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/* Snapshots of one CPU family differ from each other in a handful of bits:
+ * APIC IDs, stepping, microcode-controlled mitigation flags. A delta lists
+ * only the rows that differ from the reference, and only their bytes that
+ * differ.
+ *
+ * Layout, all integers are LEB128 varints unless noted:
+ *
+ *   count              number of rows of the decoded snapshot
+ *   op*                until the end of the buffer
+ *
+ * Every op is a varint (gap << 2 | kind). First gap rows of the reference
+ * are copied unchanged, then:
+ *
+ *   DELTA_XOR   the next reference row is copied with some bytes XORed,
+ *               followed by a patch
+ *   DELTA_DROP  the next reference row is skipped
+ *   DELTA_ADD   a row not present in the reference is inserted, followed by
+ *               varints leaf and subleaf and a patch applied to zeroes
+ *
+ * Reference rows left after the last op are copied unchanged. A patch is a
+ * 16-bit little-endian mask, bit i standing for byte i of EAX:EBX:ECX:EDX
+ * (EAX bits 7:0 being byte 0), followed by the non-zero XOR bytes.
+ */
+
+#include <string.h>
+#include <stdint.h>
+#include <stdlib.h>
+
+#include "snapshot.h"
+
+enum {
+    DELTA_XOR = 0,
+    DELTA_DROP = 1,
+    DELTA_ADD = 2,
+};
+
+#define VARINT_MAX 5
+#define PATCH_MAX (2 + 16)
+
+typedef struct {
+    uint8_t *p;
+    uint8_t *end;
+} writer_t;
+
+typedef struct {
+    const uint8_t *p;
+    const uint8_t *end;
+} reader_t;
+
+static int cmp_key(const cpuid_record_t *a, const cpuid_record_t *b) {
+    if (a->leaf != b->leaf)
+        return a->leaf < b->leaf ? -1 : 1;
+    if (a->subleaf != b->subleaf)
+        return a->subleaf < b->subleaf ? -1 : 1;
+    return 0;
+}
+
+static void put_varint(writer_t *w, uint32_t v) {
+    while (v >= 0x80) {
+        *w->p++ = (uint8_t)v | 0x80;
+        v >>= 7;
+    }
+    *w->p++ = (uint8_t)v;
+}
+
+static int get_varint(reader_t *r, uint32_t *v) {
+    uint32_t result = 0;
+    for (int shift = 0; shift < 35 && r->p < r->end; shift += 7) {
+        uint8_t b = *r->p++;
+        result |= (uint32_t)(b & 0x7f) << shift;
+        if (!(b & 0x80)) {
+            *v = result;
+            return 0;
+        }
+    }
+    return -1;
+}
+
+static void put_patch(writer_t *w, const cpuid_result_t *from,
+                      const cpuid_result_t *to) {
+    uint8_t *mask = w->p;
+    uint16_t bits = 0;
+
+    w->p += 2;
+    for (int i = 0; i < 16; ++i) {
+        uint32_t diff = cpuid_reg(from, i / 4) ^ cpuid_reg(to, i / 4);
+        uint8_t x = diff >> (8 * (i % 4));
+        if (x) {
+            bits |= 1u << i;
+            *w->p++ = x;
+        }
+    }
+    mask[0] = bits & 0xff;
+    mask[1] = bits >> 8;
+}
+
+static int apply_patch(reader_t *r, cpuid_result_t *res) {
+    if (r->end - r->p < 2)
+        return -1;
+    uint16_t bits = r->p[0] | (r->p[1] << 8);
+    r->p += 2;
+
+    for (int i = 0; bits; ++i, bits >>= 1) {
+        if (!(bits & 1))
+            continue;
+        if (r->p == r->end)
+            return -1;
+        *cpuid_reg_ptr(res, i / 4) ^= (uint32_t)*r->p++ << (8 * (i % 4));
+    }
+    return 0;
+}
+
+size_t snapshot_delta_bound(const cpuid_snapshot_t *ref,
+                            const cpuid_snapshot_t *snap) {
+    return VARINT_MAX
+           + (size_t)ref->nrecords * VARINT_MAX
+           + (size_t)snap->nrecords * (3 * VARINT_MAX + PATCH_MAX);
+}
+
+long snapshot_delta_encode(const cpuid_snapshot_t *ref,
+                           const cpuid_snapshot_t *snap,
+                           uint8_t *buf, size_t len) {
+    if (len < snapshot_delta_bound(ref, snap))
+        return -1;
+
+    writer_t w = {buf, buf + len};
+    uint32_t i = 0, j = 0, copied = 0;
+
+    put_varint(&w, snap->nrecords);
+    while (i < ref->nrecords || j < snap->nrecords) {
+        const cpuid_record_t *a = i < ref->nrecords ? &ref->records[i] : NULL;
+        const cpuid_record_t *b = j < snap->nrecords ? &snap->records[j] : NULL;
+        int c = !a ? 1 : !b ? -1 : cmp_key(a, b);
+        uint32_t gap = i - copied;
+
+        if (c == 0) {
+            i++, j++;
+            if (!memcmp(&a->r, &b->r, sizeof(a->r)))
+                continue;
+            put_varint(&w, gap << 2 | DELTA_XOR);
+            put_patch(&w, &a->r, &b->r);
+            copied = i;
+        } else if (c < 0) {
+            put_varint(&w, gap << 2 | DELTA_DROP);
+            copied = ++i;
+        } else {
+            static const cpuid_result_t zero;
+            put_varint(&w, gap << 2 | DELTA_ADD);
+            put_varint(&w, b->leaf);
+            put_varint(&w, b->subleaf);
+            put_patch(&w, &zero, &b->r);
+            copied = i;
+            j++;
+        }
+    }
+    return w.p - buf;
+}
+
+int snapshot_delta_decode(const cpuid_snapshot_t *ref,
+                          const uint8_t *buf, size_t len,
+                          cpuid_snapshot_t *snap, const char **error) {
+    reader_t r = {buf, buf + len};
+    uint32_t count;
+
+    snap->nrecords = 0;
+    snap->records = NULL;
+    if (get_varint(&r, &count) < 0 || count > ref->nrecords + len) {
+        *error = "corrupt delta header";
+        return -1;
+    }
+    snap->records = malloc((count ? count : 1) * sizeof(cpuid_record_t));
+    if (!snap->records) {
+        *error = "out of memory";
+        return -1;
+    }
+
+    cpuid_record_t *out = snap->records;
+    uint32_t i = 0, n = 0;
+    while (r.p < r.end) {
+        uint32_t op;
+        if (get_varint(&r, &op) < 0)
+            goto corrupt;
+
+        uint32_t gap = op >> 2, kind = op & 3;
+        if (gap > ref->nrecords - i || gap > count - n)
+            goto corrupt;
+        memcpy(out + n, ref->records + i, gap * sizeof(cpuid_record_t));
+        i += gap;
+        n += gap;
+
+        switch (kind) {
+            case DELTA_XOR:
+                if (i == ref->nrecords || n == count)
+                    goto corrupt;
+                out[n] = ref->records[i++];
+                if (apply_patch(&r, &out[n++].r) < 0)
+                    goto corrupt;
+                break;
+            case DELTA_DROP:
+                if (i == ref->nrecords)
+                    goto corrupt;
+                i++;
+                break;
+            case DELTA_ADD:
+                if (n == count)
+                    goto corrupt;
+                memset(&out[n], 0, sizeof(out[n]));
+                if (get_varint(&r, &out[n].leaf) < 0
+                    || get_varint(&r, &out[n].subleaf) < 0
+                    || apply_patch(&r, &out[n].r) < 0)
+                    goto corrupt;
+                n++;
+                break;
+            default:
+                goto corrupt;
+        }
+    }
+
+    if (ref->nrecords - i != count - n)
+        goto corrupt;
+    memcpy(out + n, ref->records + i, (count - n) * sizeof(cpuid_record_t));
+    snap->nrecords = count;
+
+    // DELTA_ADD can put any row anywhere, lookups need a sorted table
+    if (snapshot_validate(snap, error) < 0) {
+        snapshot_free(snap);
+        return -1;
+    }
+    return 0;
+
+corrupt:
+    *error = "corrupt delta";
+    free(snap->records);
+    snap->records = NULL;
+    return -1;
+}
+
+uint64_t snapshot_hash(const cpuid_snapshot_t *snap) {
+    uint64_t h = 0xcbf29ce484222325ull;
+
+    for (uint32_t i = 0; i < snap->nrecords; ++i) {
+        const cpuid_record_t *rec = &snap->records[i];
+        uint32_t words[6] = {rec->leaf, rec->subleaf, rec->r.eax,
+                             rec->r.ebx, rec->r.ecx, rec->r.edx};
+        for (int k = 0; k < 6; ++k) {
+            for (int b = 0; b < 4; ++b) {
+                h ^= (words[k] >> (8 * b)) & 0xff;
+                h *= 0x100000001b3ull;
+            }
+        }
+    }
+    return h;
+}
@@ -0,0 +1,369 @@
+/* Field-level comparison of two snapshots
+ *
+ * Copyright (c) 2014, 2024 Grigory Rechistov and Evgeny Yulyugin.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *   * Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *   * Redistributions in binary form must reproduce the above copyright
+ *     notice, this list of conditions and the following disclaimer in the
+ *     documentation and/or other materials provided with the distribution.
+ *   * The names of its contributors may be used to endorse or promote products
+ *     derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR
+ * ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include <string.h>
+#include <stdio.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <stdarg.h>
+
+#include "diff.h"
+#include "cpufeatures.h"
+#include "decode.h"
+
+typedef enum {
+    CAT_FEATURES,
+    CAT_CACHES,
+    CAT_TOPOLOGY,
+    CAT_MITIGATIONS,
+    CAT_IDENTIFICATION,
+    CAT_OTHER,
+    CAT_COUNT,
+} category_t;
+
+static const char *category_names[CAT_COUNT] = {
+    "Features", "Caches", "Topology", "Mitigations", "Identification",
+    "Other registers",
+};
+
+typedef enum {
+    IMPACT_NONE,
+    IMPACT_LOW,
+    IMPACT_MEDIUM,
+    IMPACT_HIGH,
+} impact_t;
+
+static const char *impact_names[] = {"none", "low", "medium", "high"};
+
+/* Register bits a change is about, ties in the report are ordered by it */
+typedef struct {
+    uint32_t leaf;
+    uint32_t subleaf;
+    uint32_t reg;
+    uint32_t bit;
+} location_t;
+
+typedef struct {
+    category_t category;
+    impact_t impact;
+    location_t where;       /* zero for changes of decoded values */
+    char text[160];
+} change_t;
+
+typedef struct {
+    change_t *items;
+    int count;
+    int capacity;
+} change_list_t;
+
+static const char *reg_names[] = {"EAX", "EBX", "ECX", "EDX"};
+
+static void add_change(change_list_t *list, category_t category,
+                       impact_t impact, const location_t *where,
+                       const char *fmt, ...) {
+    if (list->count == list->capacity) {
+        int capacity = list->capacity ? 2 * list->capacity : 32;
+        change_t *items = realloc(list->items, capacity * sizeof(change_t));
+        if (!items)
+            return;
+        list->items = items;
+        list->capacity = capacity;
+    }
+    change_t *c = &list->items[list->count++];
+    c->category = category;
+    c->impact = impact;
+    if (where)
+        c->where = *where;
+    else
+        memset(&c->where, 0, sizeof(c->where));
+
+    va_list ap;
+    va_start(ap, fmt);
+    vsnprintf(c->text, sizeof(c->text), fmt, ap);
+    va_end(ap);
+}
+
+static void format_size(uint32_t bytes, char *buf, size_t len) {
+    if (bytes && bytes % (1024 * 1024) == 0)
+        snprintf(buf, len, "%uM", bytes / (1024 * 1024));
+    else if (bytes && bytes % 1024 == 0)
+        snprintf(buf, len, "%uK", bytes / 1024);
+    else
+        snprintf(buf, len, "%u", bytes);
+}
+
+/* Bits of a register explained by the named fields below. Cache and
+ * topology fields count if either snapshot decodes them, a change there
+ * is then reported as a changed, added or removed decoded value. */
+static uint32_t covered_bits(const cpuid_snapshot_t *a, const cpuid_snapshot_t *b,
+                             uint32_t leaf, uint32_t subleaf, int reg) {
+    uint32_t mask = decode_field_bits(a, leaf, subleaf, reg)
+                  | decode_field_bits(b, leaf, subleaf, reg);
+
+    for (size_t i = 0; i < cpu_features_count; ++i) {
+        const cpu_feature_t *feat = &cpu_features[i];
+        if (feat->leaf == leaf && feat->subleaf == subleaf && feat->reg == reg)
+            mask |= 1u << feat->bit;
+    }
+    switch (leaf) {
+        case 0x0:
+        case 0x80000002:
+        case 0x80000003:
+        case 0x80000004:
+            return 0xffffffff;
+        case 0x1:
+            if (reg == REG_EAX)
+                mask |= 0x0fff3fff;
+            break;
+        case 0x80000000:
+            if (reg == REG_EAX)
+                mask = 0xffffffff;
+            break;
+    }
+    return mask;
+}
+
+static void diff_features(change_list_t *list, const cpuid_snapshot_t *a,
+                          const cpuid_snapshot_t *b) {
+    for (size_t i = 0; i < cpu_features_count; ++i) {
+        const cpu_feature_t *feat = &cpu_features[i];
+        int x = cpu_feature_present(a, feat), y = cpu_feature_present(b, feat);
+        if (x == y)
+            continue;
+
+        category_t cat = CAT_FEATURES;
+        impact_t impact = IMPACT_LOW;
+        if (feat->flags & FEATURE_MITIGATION) {
+            cat = CAT_MITIGATIONS;
+            impact = IMPACT_MEDIUM;
+        } else if (feat->flags & FEATURE_HOT) {
+            impact = IMPACT_HIGH;
+        }
+        location_t where = {feat->leaf, feat->subleaf, feat->reg, feat->bit};
+        add_change(list, cat, impact, &where, "leaf %x.%x %s %s %d->%d",
+                   feat->leaf, feat->subleaf, reg_names[feat->reg],
+                   feat->name, x, y);
+    }
+}
+
+static const char *cache_name(const cache_info_t *c, char *buf, size_t len) {
+    const char *suffix = c->type == CACHE_DATA ? "d"
+                       : c->type == CACHE_INSTRUCTION ? "i" : "";
+    snprintf(buf, len, "L%u%s", c->level, suffix);
+    return buf;
+}
+
+static void diff_caches(change_list_t *list, const cpuid_snapshot_t *a,
+                        const cpuid_snapshot_t *b) {
+    cache_info_t ca[16], cb[16];
+    int na = decode_caches(a, ca, 16), nb = decode_caches(b, cb, 16);
+    char name[8], s1[16], s2[16];
+
+    for (int i = 0; i < na; ++i) {
+        const cache_info_t *x = &ca[i], *y = NULL;
+        for (int j = 0; j < nb; ++j) {
+            if (cb[j].level == x->level && cb[j].type == x->type)
+                y = &cb[j];
+        }
+        cache_name(x, name, sizeof(name));
+        if (!y) {
+            add_change(list, CAT_CACHES, IMPACT_HIGH, NULL, "%s cache removed", name);
+            continue;
+        }
+        if (x->size != y->size) {
+            format_size(x->size, s1, sizeof(s1));
+            format_size(y->size, s2, sizeof(s2));
+            add_change(list, CAT_CACHES, IMPACT_HIGH, NULL, "%s size %s->%s",
+                       name, s1, s2);
+        }
+        if (x->line_size != y->line_size)
+            add_change(list, CAT_CACHES, IMPACT_HIGH, NULL, "%s line size %u->%u",
+                       name, x->line_size, y->line_size);
+        if (x->ways != y->ways)
+            add_change(list, CAT_CACHES, IMPACT_MEDIUM, NULL, "%s ways %u->%u",
+                       name, x->ways, y->ways);
+        if (x->sharing != y->sharing)
+            add_change(list, CAT_CACHES, IMPACT_MEDIUM, NULL,
+                       "%s shared by %u->%u logical CPUs",
+                       name, x->sharing, y->sharing);
+    }
+    for (int j = 0; j < nb; ++j) {
+        int found = 0;
+        for (int i = 0; i < na; ++i)
+            found |= ca[i].level == cb[j].level && ca[i].type == cb[j].type;
+        if (!found) {
+            format_size(cb[j].size, s2, sizeof(s2));
+            add_change(list, CAT_CACHES, IMPACT_HIGH, NULL, "%s cache added, %s",
+                       cache_name(&cb[j], name, sizeof(name)), s2);
+        }
+    }
+}
+
+static void diff_topology(change_list_t *list, const cpuid_snapshot_t *a,
+                          const cpuid_snapshot_t *b) {
+    topology_t x, y;
+    decode_topology(a, &x);
+    decode_topology(b, &y);
+
+    if (x.threads_per_core != y.threads_per_core)
+        add_change(list, CAT_TOPOLOGY, IMPACT_HIGH, NULL, "threads per core %u->%u",
+                   x.threads_per_core, y.threads_per_core);
+    if (x.logical_per_package != y.logical_per_package)
+        add_change(list, CAT_TOPOLOGY, IMPACT_HIGH, NULL,
+                   "logical CPUs per package %u->%u",
+                   x.logical_per_package, y.logical_per_package);
+    if (x.smt_shift != y.smt_shift)
+        add_change(list, CAT_TOPOLOGY, IMPACT_MEDIUM, NULL, "x2APIC shift %u->%u",
+                   x.smt_shift, y.smt_shift);
+    if (x.package_shift != y.package_shift)
+        add_change(list, CAT_TOPOLOGY, IMPACT_MEDIUM, NULL,
+                   "x2APIC package shift %u->%u",
+                   x.package_shift, y.package_shift);
+    // Every CPU has its own ID, so this matters least
+    if (x.x2apic_id != y.x2apic_id)
+        add_change(list, CAT_TOPOLOGY, IMPACT_NONE, NULL, "x2APIC ID %#x->%#x",
+                   x.x2apic_id, y.x2apic_id);
+}
+
+static void diff_identification(change_list_t *list, const cpuid_snapshot_t *a,
+                                const cpuid_snapshot_t *b) {
+    char va[13], vb[13], ba[49], bb[49];
+    uint32_t fa, ma, sa, fb, mb, sb;
+
+    snapshot_vendor(a, va);
+    snapshot_vendor(b, vb);
+    if (strcmp(va, vb))
+        add_change(list, CAT_IDENTIFICATION, IMPACT_HIGH, NULL, "vendor %s->%s", va, vb);
+
+    snapshot_signature(a, &fa, &ma, &sa);
+    snapshot_signature(b, &fb, &mb, &sb);
+    if (fa != fb || ma != mb)
+        add_change(list, CAT_IDENTIFICATION, IMPACT_HIGH, NULL,
+                   "family/model %#x/%#x->%#x/%#x", fa, ma, fb, mb);
+    if (sa != sb)
+        add_change(list, CAT_IDENTIFICATION, IMPACT_LOW, NULL, "stepping %u->%u",
+                   sa, sb);
+
+    decode_brand(a, ba);
+    decode_brand(b, bb);
+    if (strcmp(ba, bb))
+        add_change(list, CAT_IDENTIFICATION, IMPACT_LOW, NULL,
+                   "brand \"%s\"->\"%s\"", ba, bb);
+
+    uint32_t la = a->nrecords ? a->records[0].r.eax : 0;
+    uint32_t lb = b->nrecords ? b->records[0].r.eax : 0;
+    if (la != lb)
+        add_change(list, CAT_IDENTIFICATION, IMPACT_MEDIUM, NULL,
+                   "maximal leaf %#x->%#x", la, lb);
+}
+
+/* Register bits that none of the decoders above explains */
+static void diff_other(change_list_t *list, const cpuid_snapshot_t *a,
+                       const cpuid_snapshot_t *b) {
+    static const cpuid_result_t zero;
+    uint32_t i = 0, j = 0;
+
+    while (i < a->nrecords || j < b->nrecords) {
+        const cpuid_record_t *x = i < a->nrecords ? &a->records[i] : NULL;
+        const cpuid_record_t *y = j < b->nrecords ? &b->records[j] : NULL;
+        const cpuid_record_t *rec;
+        const cpuid_result_t *rx, *ry;
+
+        if (x && y && x->leaf == y->leaf && x->subleaf == y->subleaf) {
+            rec = x, rx = &x->r, ry = &y->r;
+            i++, j++;
+        } else if (x && (!y || x->leaf < y->leaf
+                         || (x->leaf == y->leaf && x->subleaf < y->subleaf))) {
+            rec = x, rx = &x->r, ry = &zero;
+            i++;
+        } else {
+            rec = y, rx = &zero, ry = &y->r;
+            j++;
+        }
+
+        for (int reg = REG_EAX; reg <= REG_EDX; ++reg) {
+            uint32_t vx = cpuid_reg(rx, reg), vy = cpuid_reg(ry, reg);
+            uint32_t mask = ~covered_bits(a, b, rec->leaf, rec->subleaf, reg);
+            location_t where = {rec->leaf, rec->subleaf, reg, 0};
+            if ((vx ^ vy) & mask)
+                add_change(list, CAT_OTHER, IMPACT_LOW, &where,
+                           "leaf %x.%x %s %#x->%#x", rec->leaf, rec->subleaf,
+                           reg_names[reg], vx, vy);
+        }
+    }
+}
+
+static int compare_change(const void *p, const void *q) {
+    const change_t *x = p, *y = q;
+    if (x->category != y->category)
+        return x->category < y->category ? -1 : 1;
+    if (x->impact != y->impact)
+        return x->impact > y->impact ? -1 : 1;
+
+    const uint32_t kx[] = {x->where.leaf, x->where.subleaf, x->where.reg, x->where.bit};
+    const uint32_t ky[] = {y->where.leaf, y->where.subleaf, y->where.reg, y->where.bit};
+    for (int i = 0; i < 4; ++i)
+        if (kx[i] != ky[i])
+            return kx[i] < ky[i] ? -1 : 1;
+    return strcmp(x->text, y->text);
+}
+
+int snapshot_diff(FILE *f, const cpuid_snapshot_t *a, const cpuid_snapshot_t *b) {
+    change_list_t list = {0};
+
+    diff_features(&list, a, b);
+    diff_caches(&list, a, b);
+    diff_topology(&list, a, b);
+    diff_identification(&list, a, b);
+    diff_other(&list, a, b);
+    qsort(list.items, list.count, sizeof(change_t), compare_change);
+
+    int high = 0;
+    for (int i = 0; i < list.count; ++i)
+        high += list.items[i].impact == IMPACT_HIGH;
+    if (list.count)
+        fprintf(f, "%d changes, %d of high impact\n\n", list.count, high);
+
+    int printed = -1;
+    for (int i = 0; i < list.count; ++i) {
+        const change_t *c = &list.items[i];
+        if ((int)c->category != printed) {
+            int n = 0;
+            while (i + n < list.count && list.items[i + n].category == c->category)
+                n++;
+            fprintf(f, "%s%s (%d)\n", printed < 0 ? "" : "\n",
+                    category_names[c->category], n);
+            printed = c->category;
+        }
+        fprintf(f, "  %-8s %s\n", impact_names[c->impact], c->text);
+    }
+    if (list.count == 0)
+        fprintf(f, "No differences\n");
+
+    int count = list.count;
+    free(list.items);
+    return count;
+}
@@ -0,0 +1,263 @@
+/* Features usable under the running kernel
+ *
+ * Copyright (c) 2014, 2024 Grigory Rechistov and Evgeny Yulyugin.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *   * Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *   * Redistributions in binary form must reproduce the above copyright
+ *     notice, this list of conditions and the following disclaimer in the
+ *     documentation and/or other materials provided with the distribution.
+ *   * The names of its contributors may be used to endorse or promote products
+ *     derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR
+ * ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/* CPUID tells what the silicon implements, but Linux may still hide a
+ * feature: boot parameters (clearcpuid=, noxsave, tsx=off), errata
+ * workarounds, or an XSAVE component the kernel does not enable in XCR0.
+ * Code that dispatches on raw CPUID then dies with SIGILL or, when the
+ * library checks XCR0 itself, silently takes a slow path. The effective
+ * feature set is CPUID intersected with the flags of /proc/cpuinfo, with
+ * the reason for every difference. */
+
+#include <string.h>
+#include <stdio.h>
+#include <stdint.h>
+#include <stdlib.h>
+
+#include "effective.h"
+
+/* XCR0 components */
+#define XSTATE_SSE          (1ull << 1)
+#define XSTATE_YMM          (1ull << 2)
+#define XSTATE_OPMASK       (1ull << 5)
+#define XSTATE_ZMM_HI256    (1ull << 6)
+#define XSTATE_HI16_ZMM     (1ull << 7)
+#define XSTATE_XTILECFG     (1ull << 17)
+#define XSTATE_XTILEDATA    (1ull << 18)
+
+#define XSTATE_AVX      (XSTATE_SSE | XSTATE_YMM)
+#define XSTATE_AVX512   (XSTATE_AVX | XSTATE_OPMASK | XSTATE_ZMM_HI256 \
+                         | XSTATE_HI16_ZMM)
+#define XSTATE_AMX      (XSTATE_XTILECFG | XSTATE_XTILEDATA)
+
+/* VEX-encoded features that need the YMM state */
+static const char *const avx_features[] = {
+    "avx", "avx2", "fma", "f16c", "vaes", "vpclmulqdq", "avx_vnni",
+    "avx_ifma", NULL,
+};
+
+static const char *const xsave_features[] = {
+    "xsave", "xsaveopt", "xsavec", "xsaves", NULL,
+};
+
+/* Boot parameters that clear features, "clearcpuid=" is handled apart */
+static const struct {
+    const char *param;
+    const char *features[4];
+} boot_params[] = {
+    {"noxsaveopt", {"xsaveopt"}},
+    {"noxsaves", {"xsaves", "xsavec"}},
+    {"tsx=off", {"rtm", "hle"}},
+    {"nopku", {"pku", "ospke"}},
+    {"nopcid", {"pcid"}},
+    {"noinvpcid", {"invpcid"}},
+    {"nosmap", {"smap"}},
+    {"nosmep", {"smep"}},
+};
+
+static int in_list(const char *const *list, const char *name) {
+    for (; *list; ++list)
+        if (!strcmp(*list, name))
+            return 1;
+    return 0;
+}
+
+/* Whether a space separated list contains the word */
+static int has_word(const char *list, const char *word, size_t len) {
+    for (const char *p = list; (p = strstr(p, word)) != NULL; p += len) {
+        if ((p == list || p[-1] == ' ') && (p[len] == ' ' || p[len] == '\n'
+                                            || p[len] == '\0'))
+            return 1;
+    }
+    return 0;
+}
+
+/* Whether a comma separated clearcpuid= value names the feature */
+static int cleared_by_clearcpuid(const char *cmdline, const char *name) {
+    size_t len = strlen(name);
+
+    for (const char *p = cmdline; (p = strstr(p, "clearcpuid=")) != NULL; ) {
+        if (p != cmdline && p[-1] != ' ') {
+            p++;
+            continue;
+        }
+        p += strlen("clearcpuid=");
+        while (*p && *p != ' ' && *p != '\n') {
+            size_t n = strcspn(p, ", \n");
+            if (n == len && !strncmp(p, name, len))
+                return 1;
+            p += n;
+            if (*p == ',')
+                p++;
+        }
+    }
+    return 0;
+}
+
+static char *read_file(const char *path) {
+    FILE *f = fopen(path, "r");
+    char *buf = NULL;
+    size_t cap = 0;
+
+    if (!f)
+        return NULL;
+    ssize_t n = getline(&buf, &cap, f);
+    fclose(f);
+    if (n < 0) {
+        free(buf);
+        return NULL;
+    }
+    return buf;
+}
+
+/* Flags of the first processor in /proc/cpuinfo */
+static char *read_cpuinfo_flags() {
+    FILE *f = fopen("/proc/cpuinfo", "r");
+    char *line = NULL;
+    size_t cap = 0;
+
+    if (!f)
+        return NULL;
+    while (getline(&line, &cap, f) >= 0) {
+        if (strncmp(line, "flags", 5))
+            continue;
+        char *colon = strchr(line, ':');
+        if (!colon)
+            break;
+        fclose(f);
+        memmove(line, colon + 1, strlen(colon + 1) + 1);
+        return line;
+    }
+    fclose(f);
+    free(line);
+    return NULL;
+}
+
+void kernel_state_read(kernel_state_t *ks) {
+    uint32_t eax, ecx;
+
+    ks->flags = read_cpuinfo_flags();
+    ks->cmdline = read_file("/proc/cmdline");
+
+    // XGETBV faults unless the OS has set CR4.OSXSAVE
+    __asm__ ("cpuid" : "=a" (eax), "=c" (ecx) : "0" (1), "1" (0) : "ebx", "edx");
+    (void)eax;
+    ks->have_xcr0 = (ecx >> 27) & 1;
+    ks->xcr0 = 0;
+    if (ks->have_xcr0) {
+        uint32_t lo, hi;
+        __asm__ ("xgetbv" : "=a" (lo), "=d" (hi) : "c" (0));
+        ks->xcr0 = (uint64_t)hi << 32 | lo;
+    }
+}
+
+void kernel_state_free(kernel_state_t *ks) {
+    free(ks->flags);
+    free(ks->cmdline);
+    ks->flags = NULL;
+    ks->cmdline = NULL;
+}
+
+/* XCR0 components a feature needs, 0 for legacy features */
+static uint64_t xstate_needed(const char *name) {
+    if (!strncmp(name, "avx512", 6))
+        return XSTATE_AVX512;
+    if (!strncmp(name, "amx_", 4))
+        return XSTATE_AMX;
+    if (in_list(avx_features, name))
+        return XSTATE_AVX;
+    return 0;
+}
+
+const char *feature_disabled_reason(const cpuid_snapshot_t *snap,
+                                    const kernel_state_t *ks,
+                                    const cpu_feature_t *f) {
+    if (!cpu_feature_present(snap, f))
+        return NULL;
+
+    uint64_t xstate = xstate_needed(f->name);
+    if (ks->cmdline) {
+        if (cleared_by_clearcpuid(ks->cmdline, f->name))
+            return "clearcpuid=";
+        if (has_word(ks->cmdline, "noxsave", 7)
+            && (xstate || in_list(xsave_features, f->name)))
+            return "noxsave";
+        for (size_t i = 0; i < sizeof(boot_params) / sizeof(boot_params[0]); ++i) {
+            if (has_word(ks->cmdline, boot_params[i].param,
+                         strlen(boot_params[i].param))
+                && in_list(boot_params[i].features, f->name))
+                return boot_params[i].param;
+        }
+    }
+
+    if (ks->have_xcr0 && (ks->xcr0 & xstate) != xstate) {
+        if (xstate == XSTATE_AMX)
+            return "XCR0 lacks AMX tile state";
+        if (xstate == XSTATE_AVX512)
+            return "XCR0 lacks AVX-512 state";
+        return "XCR0 lacks AVX state";
+    }
+
+    if (ks->flags && !(f->flags & FEATURE_NO_CPUINFO)
+        && !has_word(ks->flags, f->name, strlen(f->name)))
+        return "not in /proc/cpuinfo flags";
+    return NULL;
+}
+
+int print_effective(FILE *f, const cpuid_snapshot_t *snap,
+                    const kernel_state_t *ks) {
+    int disabled = 0;
+
+    if (!ks->flags)
+        fprintf(f, "/proc/cpuinfo is not available, only boot parameters "
+                   "and XCR0 are checked\n");
+    for (size_t i = 0; i < cpu_features_count; ++i) {
+        const char *reason = feature_disabled_reason(snap, ks, &cpu_features[i]);
+        if (!reason)
+            continue;
+        if (!disabled++)
+            fprintf(f, "Disabled by the kernel:\n");
+        fprintf(f, "  %-20s %s\n", cpu_features[i].name, reason);
+    }
+
+    fprintf(f, "Effective features:");
+    int column = 80;
+    for (size_t i = 0; i < cpu_features_count; ++i) {
+        const cpu_feature_t *feat = &cpu_features[i];
+        if (!cpu_feature_present(snap, feat)
+            || feature_disabled_reason(snap, ks, feat))
+            continue;
+        int len = strlen(feat->name);
+        if (column + len + 1 > 78) {
+            fprintf(f, "\n ");
+            column = 1;
+        }
+        fprintf(f, " %s", feat->name);
+        column += len + 1;
+    }
+    fprintf(f, "\n");
+    return disabled;
+}
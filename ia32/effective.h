@@ -0,0 +1,60 @@
+/* Features usable under the running kernel
+ *
+ * Copyright (c) 2014, 2024 Grigory Rechistov and Evgeny Yulyugin.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *   * Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *   * Redistributions in binary form must reproduce the above copyright
+ *     notice, this list of conditions and the following disclaimer in the
+ *     documentation and/or other materials provided with the distribution.
+ *   * The names of its contributors may be used to endorse or promote products
+ *     derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR
+ * ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifndef GGG_EFFECTIVE_H
+#define GGG_EFFECTIVE_H
+
+#include <stdio.h>
+#include <stdint.h>
+
+#include "snapshot.h"
+#include "cpufeatures.h"
+
+/* What the running kernel tells about CPU features */
+typedef struct {
+    char *flags;        /* "flags" line of /proc/cpuinfo, NULL if unknown */
+    char *cmdline;      /* /proc/cmdline, NULL if unknown */
+    uint64_t xcr0;
+    int have_xcr0;
+} kernel_state_t;
+
+/* Gather the state of the kernel running on this CPU */
+void kernel_state_read(kernel_state_t *ks);
+void kernel_state_free(kernel_state_t *ks);
+
+/* Why the kernel does not let programs use a feature reported by CPUID:
+ * a boot parameter, a component missing from XCR0 or a flag missing from
+ * /proc/cpuinfo. NULL if the feature is usable or not reported by CPUID. */
+const char *feature_disabled_reason(const cpuid_snapshot_t *snap,
+                                    const kernel_state_t *ks,
+                                    const cpu_feature_t *f);
+
+/* Print features disabled by the kernel with reasons, then the effective
+ * feature set. Returns the number of disabled features. */
+int print_effective(FILE *f, const cpuid_snapshot_t *snap,
+                    const kernel_state_t *ks);
+
+#endif /* GGG_EFFECTIVE_H */
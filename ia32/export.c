@@ -0,0 +1,294 @@
+/* Export snapshots as virtual machine CPU models
+ *
+ * Copyright (c) 2014, 2024 Grigory Rechistov and Evgeny Yulyugin.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *   * Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *   * Redistributions in binary form must reproduce the above copyright
+ *     notice, this list of conditions and the following disclaimer in the
+ *     documentation and/or other materials provided with the distribution.
+ *   * The names of its contributors may be used to endorse or promote products
+ *     derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR
+ * ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include <string.h>
+#include <stdio.h>
+#include <stdint.h>
+
+#include "export.h"
+#include "cpufeatures.h"
+#include "decode.h"
+
+/* From <linux/kvm.h> */
+#define KVM_CPUID_FLAG_SIGNIFCANT_INDEX 0x1
+
+/* Leaves whose output depends on the subleaf in ECX */
+static const uint32_t indexed_leaves[] = {
+    0x4, 0x7, 0xb, 0xd, 0xf, 0x10, 0x12, 0x14, 0x17, 0x18, 0x1d, 0x1e,
+    0x1f, 0x23, 0x24, 0x8000001d, 0x80000020, 0x80000026,
+};
+
+/* QEMU feature names that are not the /proc/cpuinfo ones with '_'
+ * replaced by '-'. A NULL name means QEMU has no property for the bit. */
+static const struct {
+    const char *linux_name;
+    const char *qemu_name;
+} qemu_names[] = {
+    {"dts", "ds"},
+    {"sse4_1", "sse4.1"},
+    {"sse4_2", "sse4.2"},
+    {"tsc_deadline_timer", "tsc-deadline"},
+    {"avx512_vbmi2", "avx512vbmi2"},
+    {"avx512_vnni", "avx512vnni"},
+    {"avx512_bitalg", "avx512bitalg"},
+    {"sgx_lc", "sgxlc"},
+    {"tsxldtrk", "tsx-ldtrk"},
+    {"intel_stibp", "stibp"},
+    {"spec_ctrl_ssbd", "ssbd"},
+    {"cr8_legacy", "cr8legacy"},
+    {"invariant_tsc", "invtsc"},
+    {"sdbg", NULL},
+    {"osxsave", NULL},
+    {"hypervisor", NULL},
+    {"dtherm", NULL},
+    {"ida", NULL},
+    {"pln", NULL},
+    {"pts", NULL},
+    {"hwp", NULL},
+    {"cqm", NULL},
+    {"rdt_a", NULL},
+    {"ospke", NULL},
+    {"tme", NULL},
+    {"enqcmd", NULL},
+    {"hybrid_cpu", NULL},
+    {"pconfig", NULL},
+    {"ibt", NULL},
+    {"mp", NULL},
+    {"bpext", NULL},
+    {"perfctr_llc", NULL},
+    {"mwaitx", NULL},
+    {"irperf", NULL},
+    {"rdpru", NULL},
+};
+
+static int is_indexed(const cpuid_snapshot_t *snap, uint32_t i) {
+    uint32_t leaf = snap->records[i].leaf;
+
+    for (size_t k = 0; k < sizeof(indexed_leaves) / sizeof(indexed_leaves[0]); ++k) {
+        if (indexed_leaves[k] == leaf)
+            return 1;
+    }
+    // Unknown leaves with several subleaves are indexed as well
+    return snap->records[i].subleaf != 0
+           || (i + 1 < snap->nrecords && snap->records[i + 1].leaf == leaf);
+}
+
+void export_kvm(FILE *f, const cpuid_snapshot_t *snap) {
+    fprintf(f, "/* KVM_SET_CPUID2 entries of %s. The hypervisor leaves\n"
+               " * 0x40000000+ are left to the VMM. */\n",
+            snap->host[0] ? snap->host : "this CPU");
+    fprintf(f, "static struct kvm_cpuid_entry2 ggg_cpuid_entries[%u] = {\n",
+            snap->nrecords);
+    for (uint32_t i = 0; i < snap->nrecords; ++i) {
+        const cpuid_record_t *rec = &snap->records[i];
+        fprintf(f, "    { .function = %#x, .index = %#x, .flags = %s,\n"
+                   "      .eax = %#x, .ebx = %#x, .ecx = %#x, .edx = %#x },\n",
+                rec->leaf, rec->subleaf,
+                is_indexed(snap, i) ? "KVM_CPUID_FLAG_SIGNIFCANT_INDEX" : "0",
+                rec->r.eax, rec->r.ebx, rec->r.ecx, rec->r.edx);
+    }
+    fprintf(f, "};\n");
+}
+
+/* Returns 0 and leaves buf empty if QEMU does not know the feature */
+static int qemu_name(const cpu_feature_t *feat, char *buf, size_t len) {
+    for (size_t i = 0; i < sizeof(qemu_names) / sizeof(qemu_names[0]); ++i) {
+        if (strcmp(qemu_names[i].linux_name, feat->name))
+            continue;
+        if (!qemu_names[i].qemu_name)
+            return 0;
+        snprintf(buf, len, "%s", qemu_names[i].qemu_name);
+        return 1;
+    }
+    snprintf(buf, len, "%s", feat->name);
+    for (char *p = buf; *p; ++p) {
+        if (*p == '_')
+            *p = '-';
+    }
+    return 1;
+}
+
+static const char *cache_type_name(uint32_t type) {
+    switch (type) {
+        case CACHE_DATA: return "data";
+        case CACHE_INSTRUCTION: return "instruction";
+        default: return "unified";
+    }
+}
+
+void export_qemu(FILE *f, const cpuid_snapshot_t *snap) {
+    char vendor[13], brand[49], name[32];
+    uint32_t family, model, stepping;
+    topology_t topo;
+    cache_info_t caches[16];
+
+    snapshot_vendor(snap, vendor);
+    snapshot_signature(snap, &family, &model, &stepping);
+    decode_brand(snap, brand);
+    decode_topology(snap, &topo);
+    int ncaches = decode_caches(snap, caches, 16);
+
+    const cpuid_record_t *ext = snapshot_find(snap, 0x80000000, 0);
+    const cpuid_record_t *ext8 = snapshot_find(snap, 0x80000008, 0);
+    const cpuid_record_t *tsc = snapshot_find(snap, 0x15, 0);
+
+    fprintf(f, "# QEMU CPU model of %s\n", snap->host[0] ? snap->host : "this CPU");
+    // QEMU cannot set cache sizes, its model carries them
+    for (int i = 0; i < ncaches; ++i) {
+        fprintf(f, "# L%u %s cache: %u KiB, %u-way, %u-byte lines, "
+                   "shared by %u logical CPUs\n",
+                caches[i].level, cache_type_name(caches[i].type),
+                caches[i].size / 1024, caches[i].ways, caches[i].line_size,
+                caches[i].sharing);
+    }
+
+    // Start from the minimal model and set every known feature explicitly
+    fprintf(f, "-cpu qemu64,vendor=%s,family=%u,model=%u,stepping=%u",
+            vendor, family, model, stepping);
+    if (brand[0])
+        fprintf(f, ",model-id=\"%s\"", brand);
+    fprintf(f, ",level=%u", snap->records[0].r.eax);
+    if (ext)
+        fprintf(f, ",xlevel=%#x", ext->r.eax);
+    if (ext8)
+        fprintf(f, ",phys-bits=%u", ext8->r.eax & 0xff);
+    if (tsc && tsc->r.eax && tsc->r.ebx && tsc->r.ecx)
+        fprintf(f, ",tsc-frequency=%llu",
+                (unsigned long long)tsc->r.ecx * tsc->r.ebx / tsc->r.eax);
+    fprintf(f, ",l3-cache=%s,host-cache-info=off",
+            find_cache(caches, ncaches, 3, CACHE_UNIFIED) ? "on" : "off");
+
+    for (size_t i = 0; i < cpu_features_count; ++i) {
+        const cpu_feature_t *feat = &cpu_features[i];
+        if (!qemu_name(feat, name, sizeof(name)))
+            continue;
+        fprintf(f, ",%c%s", cpu_feature_present(snap, feat) ? '+' : '-', name);
+    }
+    fprintf(f, " \\\n");
+
+    uint32_t threads = topo.threads_per_core;
+    uint32_t cores = topo.logical_per_package / threads;
+    fprintf(f, "-smp %u,sockets=1,cores=%u,threads=%u\n",
+            cores * threads, cores ? cores : 1, threads);
+}
+
+#define LABEL_PREFIX "ggg-cpuid."
+
+static int has_all(const cpuid_snapshot_t *snap, const char *const *names) {
+    for (; *names; ++names) {
+        const cpu_feature_t *feat = cpu_feature_by_name(*names, strlen(*names));
+        if (!feat || !cpu_feature_present(snap, feat))
+            return 0;
+    }
+    return 1;
+}
+
+static int has(const cpuid_snapshot_t *snap, const char *name) {
+    const char *names[] = {name, NULL};
+    return has_all(snap, names);
+}
+
+/* x86-64 microarchitecture level as defined by the psABI */
+static int microarch_level(const cpuid_snapshot_t *snap) {
+    static const char *const v1[] = {"cmov", "cx8", "fpu", "fxsr", "mmx",
+                                     "sse", "sse2", "syscall", "lm", NULL};
+    static const char *const v2[] = {"cx16", "lahf_lm", "popcnt", "pni",
+                                     "sse4_1", "sse4_2", "ssse3", NULL};
+    // The psABI asks for OSXSAVE: XSAVE the OS has not enabled is no use
+    static const char *const v3[] = {"avx", "avx2", "bmi1", "bmi2", "f16c",
+                                     "fma", "abm", "movbe", "osxsave", NULL};
+    static const char *const v4[] = {"avx512f", "avx512bw", "avx512cd",
+                                     "avx512dq", "avx512vl", NULL};
+
+    if (!has_all(snap, v1))
+        return 0;
+    if (!has_all(snap, v2))
+        return 1;
+    if (!has_all(snap, v3))
+        return 2;
+    if (!has_all(snap, v4))
+        return 3;
+    return 4;
+}
+
+static const char *bool_str(int v) {
+    return v ? "true" : "false";
+}
+
+void export_labels(FILE *f, const cpuid_snapshot_t *snap, int smt) {
+    char vendor[13];
+    uint32_t family, model, stepping;
+    topology_t topo;
+    cache_info_t caches[16];
+
+    snapshot_vendor(snap, vendor);
+    snapshot_signature(snap, &family, &model, &stepping);
+    decode_topology(snap, &topo);
+    int ncaches = decode_caches(snap, caches, 16);
+    if (smt < 0)
+        smt = topo.threads_per_core > 1;
+
+    fprintf(f, "# ggg-cpuid labels of %s\n", snap->host[0] ? snap->host : "this host");
+    fprintf(f, LABEL_PREFIX "vendor=%s\n", vendor);
+    fprintf(f, LABEL_PREFIX "family=%u\n", family);
+    fprintf(f, LABEL_PREFIX "model=%u\n", model);
+    fprintf(f, LABEL_PREFIX "stepping=%u\n", stepping);
+
+    int level = microarch_level(snap);
+    if (level)
+        fprintf(f, LABEL_PREFIX "microarch-level=x86-64-v%d\n", level);
+
+    fprintf(f, LABEL_PREFIX "avx2=%s\n", bool_str(has(snap, "avx2")));
+    fprintf(f, LABEL_PREFIX "avx512=%s\n", bool_str(has(snap, "avx512f")));
+    fprintf(f, LABEL_PREFIX "avx512-fp16=%s\n", bool_str(has(snap, "avx512_fp16")));
+    fprintf(f, LABEL_PREFIX "amx=%s\n", bool_str(has(snap, "amx_tile")));
+    fprintf(f, LABEL_PREFIX "vnni=%s\n",
+            bool_str(has(snap, "avx512_vnni") || has(snap, "avx_vnni")));
+    fprintf(f, LABEL_PREFIX "sha=%s\n", bool_str(has(snap, "sha_ni")));
+    fprintf(f, LABEL_PREFIX "vaes=%s\n", bool_str(has(snap, "vaes")));
+
+    static const struct {
+        uint32_t level;
+        uint32_t type;
+        const char *name;
+    } cache_labels[] = {
+        {1, CACHE_DATA, "l1d"},
+        {1, CACHE_INSTRUCTION, "l1i"},
+        {2, CACHE_UNIFIED, "l2"},
+        {3, CACHE_UNIFIED, "l3"},
+    };
+    for (size_t i = 0; i < sizeof(cache_labels) / sizeof(cache_labels[0]); ++i) {
+        const cache_info_t *c = find_cache(caches, ncaches, cache_labels[i].level,
+                                           cache_labels[i].type);
+        if (c)
+            fprintf(f, LABEL_PREFIX "%s-kib=%u\n", cache_labels[i].name,
+                    c->size / 1024);
+    }
+
+    fprintf(f, LABEL_PREFIX "smt=%s\n", bool_str(smt));
+    fprintf(f, LABEL_PREFIX "hybrid=%s\n", bool_str(has(snap, "hybrid_cpu")));
+    fprintf(f, LABEL_PREFIX "hypervisor=%s\n", bool_str(has(snap, "hypervisor")));
+}
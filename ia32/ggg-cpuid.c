@@ -24,6 +24,7 @@
  * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
  */
 
+#define _GNU_SOURCE
 #include <string.h>
 #include <stdio.h>
 #include <stdint.h>
@@ -32,13 +33,16 @@
 #include <errno.h>
 #include <stdlib.h>
 #include <limits.h>
+#include <sched.h>
 
-typedef struct {
-    uint32_t eax;
-    uint32_t ebx;
-    uint32_t ecx;
-    uint32_t edx;
-} cpuid_result_t;
+#include "snapshot.h"
+#include "export.h"
+#include "diff.h"
+#include "audit.h"
+#include "effective.h"
+#include "capacity.h"
+#include "decode.h"
+#include "isolation.h"
 
 static cpuid_result_t do_cpuid(uint32_t leaf, uint32_t subleaf) {
     uint32_t eax, ebx, ecx, edx;
@@ -59,7 +63,25 @@ static void print_subleaf(uint32_t leaf, uint32_t subleaf, cpuid_result_t r) {
            leaf, subleaf, r.eax, r.ebx, r.ecx, r.edx);
 }
 
-static void cpuid_leaf(uint32_t leaf) {
+static void add_subleaf(cpuid_snapshot_t *snap, uint32_t leaf,
+                        uint32_t subleaf, cpuid_result_t r) {
+    uint32_t n = snap->nrecords;
+
+    // Capacity doubles starting from 16 records
+    if (n == 0 || (n >= 16 && (n & (n - 1)) == 0)) {
+        cpuid_record_t *records = realloc(snap->records,
+                                          (n ? 2 * n : 16) * sizeof(cpuid_record_t));
+        if (!records) {
+            perror("realloc");
+            exit(1);
+        }
+        snap->records = records;
+    }
+    cpuid_record_t rec = {leaf, subleaf, r};
+    snap->records[snap->nrecords++] = rec;
+}
+
+static void cpuid_leaf(uint32_t leaf, cpuid_snapshot_t *snap) {
     const uint32_t max_subleaf_tried = 0x1000; /* Arbitrary limit */
 
     cpuid_result_t last_subleaf = {0};
@@ -108,23 +130,178 @@ static void cpuid_leaf(uint32_t leaf) {
                     return;
                 break;
         }
-        print_subleaf(leaf, subleaf, r);
+        add_subleaf(snap, leaf, subleaf, r);
         last_subleaf = r;
     }
 }
 
-static void cpuid_level(uint32_t level) {
+static void cpuid_level(uint32_t level, cpuid_snapshot_t *snap) {
     cpuid_result_t r = do_cpuid(level, 0);
     uint32_t max_leaf = r.eax;
 
     for (int leaf = level; leaf <= max_leaf; ++leaf) {
-        cpuid_leaf(leaf);
+        cpuid_leaf(leaf, snap);
+    }
+}
+
+static void dump_cpuid(cpuid_snapshot_t *snap) {
+    cpuid_level(0, snap);
+    cpuid_level(0x80000000, snap);
+}
+
+/* Pause between CPUs in IPI-free mode so that collection does not storm
+ * the rest of the machine with migrations */
+#define IPI_FREE_INTERVAL_US 10000
+
+/* Origins of per-CPU data besides the number of the CPU it was read on */
+#define SOURCE_NONE (-2)
+#define SOURCE_SAVED (-1)
+
+static int copy_snapshot(cpuid_snapshot_t *dst, const cpuid_snapshot_t *src) {
+    *dst = *src;
+    dst->records = malloc(src->nrecords * sizeof(cpuid_record_t));
+    if (!dst->records)
+        return -1;
+    memcpy(dst->records, src->records, src->nrecords * sizeof(cpuid_record_t));
+    return 0;
+}
+
+/* Fill the snapshot of an isolated CPU from an SMT sibling that was read
+ * directly, or from the saved dump. Threads of a core differ only in the
+ * low x2APIC ID bits, which follow the thread order. */
+static int infer_isolated(int i, int *cpus, int *sources, cpuid_snapshot_t *snaps,
+                          int n, const char *saved) {
+    int siblings[16];
+    int nsiblings = smt_siblings(cpus[i], siblings, 16);
+
+    for (int k = 0; k < nsiblings; ++k) {
+        for (int j = 0; j < n; ++j) {
+            if (cpus[j] != siblings[k] || sources[j] != cpus[j])
+                continue;
+
+            topology_t topo;
+            decode_topology(&snaps[j], &topo);
+            uint32_t thread = 0;
+            while (thread < nsiblings && siblings[thread] != cpus[i])
+                thread++;
+            if (copy_snapshot(&snaps[i], &snaps[j]) < 0)
+                return -1;
+            patch_apic_id(&snaps[i],
+                          (topo.x2apic_id >> topo.smt_shift << topo.smt_shift) | thread);
+            sources[i] = cpus[j];
+            return 0;
+        }
+    }
+
+    const char *error = NULL;
+    if (saved && snapshot_load_cpu(saved, cpus[i], &snaps[i], &error) == 0) {
+        sources[i] = SOURCE_SAVED;
+        return 0;
+    }
+    fprintf(stderr, "CPU %d is isolated and %s, skipped\n", cpus[i],
+            error ? error : "has no SMT sibling to copy from");
+    return -1;
+}
+
+/* Dump every CPU of the affinity mask of the process, pinning to each in
+ * turn, so that a container only sees the CPUs it may use. In IPI-free
+ * mode isolated CPUs are never run on, their data is inferred instead.
+ * Returns the number of CPUs, -1 on error. */
+static int dump_allowed_cpus(int **cpus, int **sources, cpuid_snapshot_t **snaps,
+                             int ipi_free, const char *saved) {
+    cpu_set_t allowed, isolated, one;
+
+    if (sched_getaffinity(0, sizeof(allowed), &allowed) < 0) {
+        perror("sched_getaffinity");
+        return -1;
+    }
+    CPU_ZERO(&isolated);
+    if (ipi_free)
+        isolated_cpus(&isolated);
+
+    int n = CPU_COUNT(&allowed);
+    *cpus = malloc(n * sizeof(int));
+    *sources = malloc(n * sizeof(int));
+    *snaps = calloc(n, sizeof(cpuid_snapshot_t));
+    if (!*cpus || !*sources || !*snaps) {
+        fprintf(stderr, "Out of memory\n");
+        return -1;
+    }
+
+    int count = 0, collected = 0;
+    for (int cpu = 0; cpu < CPU_SETSIZE && count < n; ++cpu) {
+        if (!CPU_ISSET(cpu, &allowed))
+            continue;
+        (*cpus)[count] = cpu;
+        (*sources)[count] = SOURCE_NONE;
+        if (CPU_ISSET(cpu, &isolated)) {
+            count++;
+            continue;
+        }
+        CPU_ZERO(&one);
+        CPU_SET(cpu, &one);
+        if (ipi_free && collected)
+            usleep(IPI_FREE_INTERVAL_US);
+        if (sched_setaffinity(0, sizeof(one), &one) < 0) {
+            perror("sched_setaffinity");
+            continue;
+        }
+        (*sources)[count] = cpu;
+        dump_cpuid(&(*snaps)[count++]);
+        collected++;
+    }
+
+    // Stay off the isolated CPUs until exit rather than land on one of them
+    CPU_XOR(&one, &allowed, &isolated);
+    CPU_AND(&one, &one, &allowed);
+    sched_setaffinity(0, sizeof(one), &one);
+
+    // Inferred snapshots are only copied from ones read directly, so
+    // the result does not depend on the order of CPUs
+    for (int i = 0; i < count; ++i) {
+        if ((*sources)[i] == SOURCE_NONE)
+            infer_isolated(i, *cpus, *sources, *snaps, count, saved);
+    }
+
+    int kept = 0;
+    for (int i = 0; i < count; ++i) {
+        if ((*sources)[i] == SOURCE_NONE)
+            continue;
+        (*cpus)[kept] = (*cpus)[i];
+        (*sources)[kept] = (*sources)[i];
+        (*snaps)[kept++] = (*snaps)[i];
+    }
+    return kept;
+}
+
+/* Print rows of the snapshot, all of them or only those of a leaf and
+ * a subleaf when they are not 0xffffffff */
+static void print_snapshot(const cpuid_snapshot_t *snap,
+                           uint32_t leaf, uint32_t subleaf) {
+    printf("Leaf             Subleaf         EAX         EBX        ECX          EDX\n");
+    printf("------------------------------------------------------------------------\n");
+
+    for (uint32_t i = 0; i < snap->nrecords; ++i) {
+        const cpuid_record_t *rec = &snap->records[i];
+        if (leaf != 0xffffffff && rec->leaf != leaf)
+            continue;
+        if (subleaf != 0xffffffff && rec->subleaf != subleaf)
+            continue;
+        print_subleaf(rec->leaf, rec->subleaf, rec->r);
     }
 }
 
-static void dump_cpuid() {
-    cpuid_level(0);
-    cpuid_level(0x80000000);
+/* SMT state of the running kernel, -1 if unknown */
+static int smt_active() {
+    FILE *f = fopen("/sys/devices/system/cpu/smt/active", "r");
+    int active = -1;
+
+    if (f) {
+        if (fscanf(f, "%d", &active) != 1)
+            active = -1;
+        fclose(f);
+    }
+    return active;
 }
 
 static void print_help() {
@@ -134,17 +311,44 @@ static void print_help() {
     printf("\t-h, --help\tPrint usage and exit.\n");
     printf("\t-l, --leaf\tPrint just this leaf\n");
     printf("\t-s, --subleaf\tUse this particular subleaf\n");
+    printf("\t-i, --input\tRead a saved dump instead of this CPU\n");
+    printf("\t-e, --export\tPrint in another format: kvm (KVM_SET_CPUID2 entries),\n"
+           "\t\t\tqemu (-cpu and -smp options) or labels (node labels)\n");
+    printf("\t-d, --diff\tShow decoded fields that differ from the dump (-i or this CPU)\n"
+           "\t\t\tto this saved dump\n");
+    printf("\t-a, --audit\tList features of the physical CPU model hidden by the\n"
+           "\t\t\tvirtual CPU model\n");
+    printf("\t-k, --kernel\tList features the running kernel disables and the\n"
+           "\t\t\teffective feature set\n");
+    printf("\t-p, --per-cpu\tDump every CPU this process may run on\n");
+    printf("\t-c, --capacity\tReport allowed CPUs, cgroup CPU quota, physical cores\n"
+           "\t\t\tand L3 domains they cover\n");
+    printf("\t-f, --ipi-free\tWith -p or -c, never run on isolcpus/nohz_full CPUs,\n"
+           "\t\t\tcopy their data from SMT siblings and pace collection\n");
+    printf("\t-S, --saved\tTake isolated CPUs without a sibling from this -p dump\n");
 }
 
 int main(int argc, char **argv) {
     // Parse command line arguments
     int opt = 0, opt_idx = 0;
-    const char *short_options = "hl:s:";
+    const char *short_options = "hl:s:i:e:d:akpcfS:";
     uint32_t leaf = 0xffffffff, subleaf = 0xffffffff;
+    const char *input = NULL, *export = NULL, *diff = NULL;
+    int audit = 0, kernel = 0, per_cpu = 0, capacity = 0, ipi_free = 0;
+    const char *saved = NULL;
     static struct option long_opt[] = {
         {"help", no_argument, NULL, 'h'},
         {"leaf", required_argument, NULL, 'l'},
         {"subleaf", required_argument, NULL, 's'},
+        {"input", required_argument, NULL, 'i'},
+        {"export", required_argument, NULL, 'e'},
+        {"diff", required_argument, NULL, 'd'},
+        {"audit", no_argument, NULL, 'a'},
+        {"kernel", no_argument, NULL, 'k'},
+        {"per-cpu", no_argument, NULL, 'p'},
+        {"capacity", no_argument, NULL, 'c'},
+        {"ipi-free", no_argument, NULL, 'f'},
+        {"saved", required_argument, NULL, 'S'},
         {NULL, 0, NULL, 0}
     };
     while ((opt = getopt_long(argc, argv, short_options,
@@ -186,6 +390,38 @@ int main(int argc, char **argv) {
                     return 1;
                 }
 
+                break;
+            case 'i':
+                input = optarg;
+                break;
+            case 'e':
+                if (strcmp(optarg, "kvm") && strcmp(optarg, "qemu")
+                    && strcmp(optarg, "labels")) {
+                    fprintf(stderr, "Unknown export format %s\n", optarg);
+                    return 1;
+                }
+                export = optarg;
+                break;
+            case 'd':
+                diff = optarg;
+                break;
+            case 'a':
+                audit = 1;
+                break;
+            case 'k':
+                kernel = 1;
+                break;
+            case 'p':
+                per_cpu = 1;
+                break;
+            case 'c':
+                capacity = 1;
+                break;
+            case 'f':
+                ipi_free = 1;
+                break;
+            case 'S':
+                saved = optarg;
                 break;
             case '?':
                 printf("Use -h, --help options to get usage.\n");
@@ -197,19 +433,79 @@ int main(int argc, char **argv) {
         }
     }
 
-    printf("Leaf             Subleaf         EAX         EBX        ECX          EDX\n");
-    printf("------------------------------------------------------------------------\n");
+    if ((kernel || per_cpu || capacity || ipi_free) && input) {
+        fprintf(stderr, "-k, -p, -c and -f are only available for this machine\n");
+        return 1;
+    }
 
-    if (leaf != 0xffffffff) {
-        if (subleaf != 0xffffffff) {
-            cpuid_result_t r = do_cpuid(leaf, subleaf);
-            print_subleaf(leaf, subleaf, r);
-        } else {
-            cpuid_leaf(leaf);
+    if (ipi_free && !capacity)
+        per_cpu = 1;
+    if (per_cpu || capacity) {
+        int *cpus, *sources;
+        cpuid_snapshot_t *snaps;
+        int n = dump_allowed_cpus(&cpus, &sources, &snaps, ipi_free, saved);
+        if (n < 0)
+            return 1;
+        if (capacity)
+            print_capacity(stdout, cpus, snaps, n);
+        for (int i = 0; i < n; ++i) {
+            if (!capacity) {
+                printf("%sCPU %d:", i ? "\n" : "", cpus[i]);
+                if (sources[i] == SOURCE_SAVED)
+                    printf(" (isolated, from %s)", saved);
+                else if (sources[i] != cpus[i])
+                    printf(" (isolated, copied from CPU %d)", sources[i]);
+                printf("\n");
+                print_snapshot(&snaps[i], leaf, subleaf);
+            }
+            snapshot_free(&snaps[i]);
         }
+        free(cpus);
+        free(sources);
+        free(snaps);
+        return 0;
+    }
+
+    cpuid_snapshot_t snap = {{0}};
+    if (input) {
+        const char *error = NULL;
+        if (snapshot_load(input, &snap, &error) < 0) {
+            fprintf(stderr, "%s: %s\n", input, error);
+            return 1;
+        }
+    } else if (leaf != 0xffffffff && subleaf != 0xffffffff) {
+        add_subleaf(&snap, leaf, subleaf, do_cpuid(leaf, subleaf));
+    } else if (leaf != 0xffffffff) {
+        cpuid_leaf(leaf, &snap);
     } else {
-        dump_cpuid();
+        dump_cpuid(&snap);
     }
 
+    if (diff) {
+        cpuid_snapshot_t other;
+        const char *error = NULL;
+        if (snapshot_load(diff, &other, &error) < 0) {
+            fprintf(stderr, "%s: %s\n", diff, error);
+            return 1;
+        }
+        snapshot_diff(stdout, &snap, &other);
+        snapshot_free(&other);
+    } else if (kernel) {
+        kernel_state_t ks;
+        kernel_state_read(&ks);
+        print_effective(stdout, &snap, &ks);
+        kernel_state_free(&ks);
+    } else if (audit)
+        audit_masking(stdout, &snap);
+    else if (export && !strcmp(export, "kvm"))
+        export_kvm(stdout, &snap);
+    else if (export && !strcmp(export, "qemu"))
+        export_qemu(stdout, &snap);
+    else if (export)
+        export_labels(stdout, &snap, input ? -1 : smt_active());
+    else
+        print_snapshot(&snap, leaf, subleaf);
+
+    snapshot_free(&snap);
     return 0;
 }
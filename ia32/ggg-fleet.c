@@ -0,0 +1,543 @@
+/* Load saved ggg-cpuid-ia32 dumps of many hosts into a fleet table
+ *
+ * Copyright (c) 2014, 2024 Grigory Rechistov and Evgeny Yulyugin.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *   * Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *   * Redistributions in binary form must reproduce the above copyright
+ *     notice, this list of conditions and the following disclaimer in the
+ *     documentation and/or other materials provided with the distribution.
+ *   * The names of its contributors may be used to endorse or promote products
+ *     derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR
+ * ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include <string.h>
+#include <stdio.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <stdatomic.h>
+#include <unistd.h>
+#include <getopt.h>
+#include <errno.h>
+#include <limits.h>
+#include <pthread.h>
+#include <dirent.h>
+#include <time.h>
+#include <sys/stat.h>
+
+#include "snapshot.h"
+
+typedef struct {
+    char **paths;
+    size_t count;
+    size_t capacity;
+} path_list_t;
+
+typedef struct {
+    cpuid_snapshot_t *items;
+    size_t count;
+    size_t capacity;
+} snapshot_vec_t;
+
+/* Each worker owns a contiguous range of input files. An idle worker
+ * claims the remaining files of the other workers' ranges, so both owner
+ * and thieves take items with an atomic increment of the same cursor.
+ * Parsed snapshots go to a private buffer which is only merged after all
+ * workers are joined. */
+typedef struct {
+    _Alignas(64) atomic_size_t next;
+    size_t end;
+    pthread_t thread;
+    int id;
+    snapshot_vec_t out;
+    size_t rejected;
+} worker_t;
+
+typedef struct {
+    const path_list_t *files;
+    const cpuid_snapshot_t *ref;
+    worker_t *workers;
+    int nworkers;
+} pool_t;
+
+/* An archive holds many snapshots delta-encoded against one reference:
+ *
+ *   ARCHIVE_MAGIC, 8-byte little-endian snapshot_hash() of the reference,
+ *   then per snapshot: 1-byte host name length, host name,
+ *   2-byte little-endian delta length, delta.
+ */
+#define ARCHIVE_MAGIC "GGGD1\n"
+#define ARCHIVE_MAGIC_LEN 6
+
+static pool_t pool;
+
+static int path_list_add(path_list_t *list, const char *path) {
+    if (list->count == list->capacity) {
+        size_t capacity = list->capacity ? 2 * list->capacity : 256;
+        char **paths = realloc(list->paths, capacity * sizeof(char *));
+        if (!paths)
+            return -1;
+        list->paths = paths;
+        list->capacity = capacity;
+    }
+    list->paths[list->count] = strdup(path);
+    if (!list->paths[list->count])
+        return -1;
+    list->count++;
+    return 0;
+}
+
+/* A directory argument stands for all regular files in it */
+static int collect_inputs(const char *arg, path_list_t *list) {
+    struct stat st;
+    if (stat(arg, &st) < 0) {
+        perror(arg);
+        return -1;
+    }
+    if (!S_ISDIR(st.st_mode))
+        return path_list_add(list, arg);
+
+    DIR *dir = opendir(arg);
+    if (!dir) {
+        perror(arg);
+        return -1;
+    }
+    struct dirent *de;
+    char path[PATH_MAX];
+    while ((de = readdir(dir)) != NULL) {
+        if (de->d_name[0] == '.')
+            continue;
+        snprintf(path, sizeof(path), "%s/%s", arg, de->d_name);
+        if (stat(path, &st) < 0 || !S_ISREG(st.st_mode))
+            continue;
+        if (path_list_add(list, path) < 0) {
+            closedir(dir);
+            return -1;
+        }
+    }
+    closedir(dir);
+    return 0;
+}
+
+static int snapshot_vec_push(snapshot_vec_t *vec, const cpuid_snapshot_t *snap) {
+    if (vec->count == vec->capacity) {
+        size_t capacity = vec->capacity ? 2 * vec->capacity : 64;
+        cpuid_snapshot_t *items = realloc(vec->items,
+                                          capacity * sizeof(cpuid_snapshot_t));
+        if (!items)
+            return -1;
+        vec->items = items;
+        vec->capacity = capacity;
+    }
+    vec->items[vec->count++] = *snap;
+    return 0;
+}
+
+static void ingest_archive(worker_t *self, const char *path,
+                           const uint8_t *p, const uint8_t *end) {
+    const cpuid_snapshot_t *ref = pool.ref;
+    const char *error = NULL;
+
+    if (!ref) {
+        fprintf(stderr, "%s: rejected: archive needs a reference\n", path);
+        self->rejected++;
+        return;
+    }
+    uint64_t hash = 0;
+    for (int i = 0; i < 8 && p + i < end; ++i)
+        hash |= (uint64_t)p[i] << (8 * i);
+    p += 8;
+    if (p > end || hash != snapshot_hash(ref)) {
+        fprintf(stderr, "%s: rejected: archive of another reference\n", path);
+        self->rejected++;
+        return;
+    }
+
+    while (p < end) {
+        cpuid_snapshot_t snap;
+        size_t host_len = *p++;
+        if (host_len >= SNAPSHOT_HOST_LEN || end - p < (long)host_len + 2)
+            goto corrupt;
+        memcpy(snap.host, p, host_len);
+        snap.host[host_len] = '\0';
+        p += host_len;
+
+        size_t len = p[0] | (p[1] << 8);
+        p += 2;
+        if ((size_t)(end - p) < len)
+            goto corrupt;
+        if (snapshot_delta_decode(ref, p, len, &snap, &error) < 0) {
+            fprintf(stderr, "%s: %s: rejected: %s\n", path, snap.host, error);
+            self->rejected++;
+        } else if (snapshot_vec_push(&self->out, &snap) < 0) {
+            snapshot_free(&snap);
+            self->rejected++;
+        }
+        p += len;
+    }
+    return;
+
+corrupt:
+    fprintf(stderr, "%s: rejected: truncated archive\n", path);
+    self->rejected++;
+}
+
+static void ingest_one(worker_t *self, size_t idx) {
+    const char *path = pool.files->paths[idx];
+    const char *error = NULL;
+    const char *buf;
+    size_t len;
+    cpuid_snapshot_t snap;
+
+    if (snapshot_map_file(path, &buf, &len, &error) < 0) {
+        fprintf(stderr, "%s: rejected: %s\n", path, error);
+        self->rejected++;
+        return;
+    }
+
+    if (len >= ARCHIVE_MAGIC_LEN && !memcmp(buf, ARCHIVE_MAGIC, ARCHIVE_MAGIC_LEN)) {
+        ingest_archive(self, path, (const uint8_t *)buf + ARCHIVE_MAGIC_LEN,
+                       (const uint8_t *)buf + len);
+    } else if (snapshot_import(buf, len, &snap, &error) < 0) {
+        fprintf(stderr, "%s: rejected: %s\n", path, error);
+        self->rejected++;
+    } else {
+        snapshot_host_from_path(path, snap.host);
+        if (snapshot_vec_push(&self->out, &snap) < 0) {
+            fprintf(stderr, "%s: rejected: out of memory\n", path);
+            snapshot_free(&snap);
+            self->rejected++;
+        }
+    }
+    snapshot_unmap_file(buf, len);
+}
+
+static int claim(worker_t *w, size_t *idx) {
+    if (atomic_load_explicit(&w->next, memory_order_relaxed) >= w->end)
+        return 0;
+    *idx = atomic_fetch_add_explicit(&w->next, 1, memory_order_relaxed);
+    return *idx < w->end;
+}
+
+static void *worker_main(void *arg) {
+    worker_t *self = arg;
+    size_t idx;
+
+    while (claim(self, &idx))
+        ingest_one(self, idx);
+
+    // Own range is done, help the others
+    for (int i = 1; i < pool.nworkers; ++i) {
+        worker_t *victim = &pool.workers[(self->id + i) % pool.nworkers];
+        while (claim(victim, &idx))
+            ingest_one(self, idx);
+    }
+    return NULL;
+}
+
+static int compare_host(const void *a, const void *b) {
+    return strcmp(((const cpuid_snapshot_t *)a)->host,
+                  ((const cpuid_snapshot_t *)b)->host);
+}
+
+/* Ingest all files with nworkers threads and merge the per-thread results
+ * into one table sorted by host name */
+static int ingest(const path_list_t *files, int nworkers,
+                  snapshot_vec_t *fleet, size_t *rejected) {
+    pool.files = files;
+    pool.nworkers = nworkers;
+    pool.workers = aligned_alloc(64, nworkers * sizeof(worker_t));
+    if (!pool.workers)
+        return -1;
+
+    size_t chunk = files->count / nworkers, rest = files->count % nworkers;
+    size_t begin = 0;
+    for (int i = 0; i < nworkers; ++i) {
+        worker_t *w = &pool.workers[i];
+        memset(w, 0, sizeof(*w));
+        w->id = i;
+        w->end = begin + chunk + (i < rest ? 1 : 0);
+        atomic_init(&w->next, begin);
+        begin = w->end;
+    }
+
+    int started = 0;
+    for (; started < nworkers; ++started) {
+        worker_t *w = &pool.workers[started];
+        if (pthread_create(&w->thread, NULL, worker_main, w) != 0)
+            break;
+    }
+    // Threads that could not be created are covered by stealing, unless
+    // none were started at all
+    if (started == 0)
+        worker_main(&pool.workers[0]);
+    for (int i = 0; i < started; ++i)
+        pthread_join(pool.workers[i].thread, NULL);
+
+    size_t total = 0;
+    *rejected = 0;
+    for (int i = 0; i < nworkers; ++i) {
+        total += pool.workers[i].out.count;
+        *rejected += pool.workers[i].rejected;
+    }
+
+    fleet->items = malloc((total ? total : 1) * sizeof(cpuid_snapshot_t));
+    if (!fleet->items)
+        return -1;
+    fleet->count = fleet->capacity = 0;
+    for (int i = 0; i < nworkers; ++i) {
+        snapshot_vec_t *out = &pool.workers[i].out;
+        memcpy(fleet->items + fleet->count, out->items,
+               out->count * sizeof(cpuid_snapshot_t));
+        fleet->count += out->count;
+        free(out->items);
+    }
+    fleet->capacity = total;
+    free(pool.workers);
+
+    qsort(fleet->items, fleet->count, sizeof(cpuid_snapshot_t), compare_host);
+    return 0;
+}
+
+typedef struct {
+    char vendor[13];
+    uint32_t family, model, stepping;
+    size_t hosts;
+} model_count_t;
+
+static int compare_model(const void *a, const void *b) {
+    const model_count_t *x = a, *y = b;
+    int c = strcmp(x->vendor, y->vendor);
+    if (c)
+        return c;
+    if (x->family != y->family)
+        return x->family < y->family ? -1 : 1;
+    if (x->model != y->model)
+        return x->model < y->model ? -1 : 1;
+    if (x->stepping != y->stepping)
+        return x->stepping < y->stepping ? -1 : 1;
+    return 0;
+}
+
+static void print_summary(const snapshot_vec_t *fleet) {
+    model_count_t *models = calloc(fleet->count ? fleet->count : 1,
+                                   sizeof(model_count_t));
+    if (!models)
+        return;
+
+    for (size_t i = 0; i < fleet->count; ++i) {
+        snapshot_vendor(&fleet->items[i], models[i].vendor);
+        snapshot_signature(&fleet->items[i], &models[i].family,
+                           &models[i].model, &models[i].stepping);
+    }
+    qsort(models, fleet->count, sizeof(model_count_t), compare_model);
+
+    printf("Vendor           Family       Model    Stepping       Hosts\n");
+    printf("-----------------------------------------------------------\n");
+    for (size_t i = 0; i < fleet->count; ) {
+        size_t j = i;
+        while (j < fleet->count && !compare_model(&models[i], &models[j]))
+            j++;
+        printf("%-12s  %#10x  %#10x  %#10x  %10zu\n", models[i].vendor,
+               models[i].family, models[i].model, models[i].stepping, j - i);
+        i = j;
+    }
+    free(models);
+}
+
+/* Write all snapshots delta-encoded against ref */
+/* fwrite() that reports short writes as errors */
+static int write_all(FILE *f, const void *data, size_t len) {
+    return fwrite(data, 1, len, f) == len ? 0 : -1;
+}
+
+static int pack(const char *path, const cpuid_snapshot_t *ref,
+                const snapshot_vec_t *fleet) {
+    FILE *f = fopen(path, "wb");
+    if (!f) {
+        perror(path);
+        return -1;
+    }
+
+    uint64_t hash = snapshot_hash(ref);
+    uint8_t header[8];
+    for (int i = 0; i < 8; ++i)
+        header[i] = hash >> (8 * i);
+    if (write_all(f, ARCHIVE_MAGIC, ARCHIVE_MAGIC_LEN) < 0
+        || write_all(f, header, sizeof(header)) < 0)
+        goto write_error;
+
+    size_t total = 0, hosts = 0;
+    uint8_t *buf = NULL;
+    for (size_t i = 0; i < fleet->count; ++i) {
+        const cpuid_snapshot_t *snap = &fleet->items[i];
+        size_t bound = snapshot_delta_bound(ref, snap);
+        uint8_t *tmp = realloc(buf, bound);
+        if (!tmp) {
+            perror("pack");
+            free(buf);
+            fclose(f);
+            return -1;
+        }
+        buf = tmp;
+
+        long len = snapshot_delta_encode(ref, snap, buf, bound);
+        if (len < 0 || len > 0xffff) {
+            fprintf(stderr, "%s: too different from the reference, skipped\n",
+                    snap->host);
+            continue;
+        }
+        uint8_t host_len = strlen(snap->host);
+        uint8_t delta_len[2] = {len & 0xff, len >> 8};
+        if (write_all(f, &host_len, 1) < 0
+            || write_all(f, snap->host, host_len) < 0
+            || write_all(f, delta_len, 2) < 0
+            || write_all(f, buf, len) < 0) {
+            free(buf);
+            goto write_error;
+        }
+        total += len;
+        hosts++;
+    }
+    free(buf);
+
+    if (fclose(f) != 0) {
+        perror(path);
+        return -1;
+    }
+    fprintf(stderr, "Packed %zu hosts into %zu delta bytes (%.1f per host)\n",
+            hosts, total, hosts ? (double)total / hosts : 0.0);
+    return 0;
+
+write_error:
+    perror(path);
+    fclose(f);
+    return -1;
+}
+
+static void print_help() {
+    printf("ggg-fleet\n\n");
+    printf("USAGE: ggg-fleet [options] FILE|DIR...\n\n");
+    printf("Options:\n");
+    printf("\t-h, --help\tPrint usage and exit.\n");
+    printf("\t-j, --jobs\tNumber of ingestion threads (default: online CPUs)\n");
+    printf("\t-r, --reference\tReference dump for delta archives\n");
+    printf("\t-p, --pack\tWrite loaded dumps to this archive as deltas against the reference\n");
+}
+
+int main(int argc, char **argv) {
+    // Parse command line arguments
+    int opt = 0, opt_idx = 0;
+    const char *short_options = "hj:r:p:";
+    long jobs = sysconf(_SC_NPROCESSORS_ONLN);
+    const char *ref_path = NULL, *pack_path = NULL;
+    static struct option long_opt[] = {
+        {"help", no_argument, NULL, 'h'},
+        {"jobs", required_argument, NULL, 'j'},
+        {"reference", required_argument, NULL, 'r'},
+        {"pack", required_argument, NULL, 'p'},
+        {NULL, 0, NULL, 0}
+    };
+    while ((opt = getopt_long(argc, argv, short_options,
+                              long_opt, &opt_idx)) != -1) {
+        switch (opt) {
+            case 'j':
+                errno = 0;  /* To distinguish success/failure after call */
+                char *endptr;
+                jobs = strtol(optarg, &endptr, 10);
+                if (errno != 0 || endptr == optarg || jobs < 1 || jobs > 1024) {
+                    fprintf(stderr, "Invalid number of jobs\n");
+                    return 1;
+                }
+                break;
+            case 'r':
+                ref_path = optarg;
+                break;
+            case 'p':
+                pack_path = optarg;
+                break;
+            case '?':
+                printf("Use -h, --help options to get usage.\n");
+                return 0;
+            case 'h':
+            default:
+                print_help();
+                return 0;
+        }
+    }
+    if (optind == argc) {
+        print_help();
+        return 1;
+    }
+    if (jobs < 1)
+        jobs = 1;
+
+    if (pack_path && !ref_path) {
+        fprintf(stderr, "Packing needs a reference dump\n");
+        return 1;
+    }
+    cpuid_snapshot_t ref;
+    if (ref_path) {
+        const char *error = NULL;
+        if (snapshot_load(ref_path, &ref, &error) < 0) {
+            fprintf(stderr, "%s: %s\n", ref_path, error);
+            return 1;
+        }
+        pool.ref = &ref;
+    }
+
+    path_list_t files = {0};
+    for (int i = optind; i < argc; ++i) {
+        if (collect_inputs(argv[i], &files) < 0)
+            return 1;
+    }
+    if (files.count == 0) {
+        fprintf(stderr, "No input files\n");
+        return 1;
+    }
+    if ((size_t)jobs > files.count)
+        jobs = files.count;
+
+    struct timespec start, stop;
+    clock_gettime(CLOCK_MONOTONIC, &start);
+
+    snapshot_vec_t fleet = {0};
+    size_t rejected = 0;
+    if (ingest(&files, jobs, &fleet, &rejected) < 0) {
+        perror("ingest");
+        return 1;
+    }
+
+    clock_gettime(CLOCK_MONOTONIC, &stop);
+    double elapsed = (stop.tv_sec - start.tv_sec)
+                     + (stop.tv_nsec - start.tv_nsec) / 1e9;
+    fprintf(stderr, "Loaded %zu hosts, rejected %zu files in %.3f s "
+            "with %ld threads\n", fleet.count, rejected, elapsed, jobs);
+
+    print_summary(&fleet);
+    if (pack_path && pack(pack_path, &ref, &fleet) < 0)
+        return 1;
+
+    for (size_t i = 0; i < fleet.count; ++i)
+        snapshot_free(&fleet.items[i]);
+    free(fleet.items);
+    for (size_t i = 0; i < files.count; ++i)
+        free(files.paths[i]);
+    free(files.paths);
+    if (ref_path)
+        snapshot_free(&ref);
+    return 0;
+}
@@ -0,0 +1,506 @@
+/* Import CPUID dumps of other tools as snapshots
+ *
+ * Copyright (c) 2014, 2024 Grigory Rechistov and Evgeny Yulyugin.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *   * Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *   * Redistributions in binary form must reproduce the above copyright
+ *     notice, this list of conditions and the following disclaimer in the
+ *     documentation and/or other materials provided with the distribution.
+ *   * The names of its contributors may be used to endorse or promote products
+ *     derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR
+ * ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/* Supported formats, only the first CPU of multi-CPU dumps is taken:
+ *
+ *  - ggg-cpuid-ia32 output, see snapshot_parse();
+ *  - raw dumps of Todd Allen's cpuid, "cpuid -r":
+ *      0x00000007 0x00: eax=0x00000002 ebx=0xf1bf27eb ecx=... edx=...
+ *  - AIDA64 CPUID dumps, which InstLatx64 publishes:
+ *      CPUID 00000007: 00000002-F1BF27EB-1B415FDE-BFD14410 [SL 00]
+ *  - /proc/cpuinfo. Only vendor, signature, brand string and the feature
+ *    bits named in "flags" can be restored from it.
+ *
+ * Leaves outside of the basic and extended ranges, e.g. hypervisor ones,
+ * are dropped.
+ */
+
+#include <string.h>
+#include <stdio.h>
+#include <stdint.h>
+#include <stdlib.h>
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
+#include "snapshot.h"
+#include "cpufeatures.h"
+
+typedef struct {
+    const char *p;
+    const char *end;
+} cursor_t;
+
+typedef struct {
+    cpuid_record_t *records;
+    uint32_t count;
+    uint32_t capacity;
+} builder_t;
+
+/* Parse exactly 8 hex digits at p, which must be readable. SSE2 converts
+ * all digits at once and the nibbles are then packed with SWAR steps. */
+static int parse_hex8(const char *p, uint32_t *val) {
+#ifdef __SSE2__
+    __m128i v = _mm_loadl_epi64((const __m128i *)p);
+    // Digits already have bit 5 set, letters become lower case
+    __m128i lower = _mm_or_si128(v, _mm_set1_epi8(0x20));
+    __m128i d = _mm_sub_epi8(lower, _mm_set1_epi8('0'));
+    __m128i l = _mm_sub_epi8(lower, _mm_set1_epi8('a'));
+    __m128i is_d = _mm_cmpeq_epi8(_mm_min_epu8(d, _mm_set1_epi8(9)), d);
+    __m128i is_l = _mm_cmpeq_epi8(_mm_min_epu8(l, _mm_set1_epi8(5)), l);
+    if ((_mm_movemask_epi8(_mm_or_si128(is_d, is_l)) & 0xff) != 0xff)
+        return -1;
+    l = _mm_add_epi8(l, _mm_set1_epi8(10));
+    __m128i nib = _mm_or_si128(_mm_and_si128(is_d, d),
+                               _mm_andnot_si128(is_d, l));
+    // _mm_cvtsi128_si64() is x86-64 only, take the halves one by one
+    uint64_t x = (uint32_t)_mm_cvtsi128_si32(nib)
+               | (uint64_t)(uint32_t)_mm_cvtsi128_si32(_mm_srli_epi64(nib, 32)) << 32;
+#else
+    uint64_t x = 0;
+    for (int i = 0; i < 8; ++i) {
+        char c = p[i] | 0x20;
+        uint64_t n;
+        if (c >= '0' && c <= '9')
+            n = c - '0';
+        else if (c >= 'a' && c <= 'f')
+            n = c - 'a' + 10;
+        else
+            return -1;
+        x |= n << (8 * i);
+    }
+#endif
+    // Byte i holds the nibble of digit i, the first digit is the most
+    // significant one
+    x = ((x & 0x000f000f000f000full) << 4) | ((x >> 8) & 0x000f000f000f000full);
+    x = ((x & 0x000000ff000000ffull) << 8) | ((x >> 16) & 0x000000ff000000ffull);
+    *val = (uint32_t)(((x & 0xffff) << 16) | ((x >> 32) & 0xffff));
+    return 0;
+}
+
+static int take_hex8(cursor_t *c, uint32_t *val) {
+    if (c->end - c->p < 8 || parse_hex8(c->p, val) < 0)
+        return -1;
+    c->p += 8;
+    return 0;
+}
+
+/* Up to 8 hex digits of any length */
+static int take_hex(cursor_t *c, uint32_t *val) {
+    uint32_t v = 0;
+    const char *start = c->p;
+    while (c->p < c->end && c->p - start < 8) {
+        char ch = *c->p | 0x20;
+        if (ch >= '0' && ch <= '9')
+            v = (v << 4) | (ch - '0');
+        else if (ch >= 'a' && ch <= 'f')
+            v = (v << 4) | (ch - 'a' + 10);
+        else
+            break;
+        c->p++;
+    }
+    *val = v;
+    return c->p == start ? -1 : 0;
+}
+
+static int take(cursor_t *c, const char *s) {
+    size_t n = strlen(s);
+    if ((size_t)(c->end - c->p) < n || memcmp(c->p, s, n))
+        return -1;
+    c->p += n;
+    return 0;
+}
+
+static void skip_spaces(cursor_t *c) {
+    while (c->p < c->end && (*c->p == ' ' || *c->p == '\t'))
+        c->p++;
+}
+
+static int starts_with(const char *p, const char *end, const char *s) {
+    size_t n = strlen(s);
+    return (size_t)(end - p) >= n && !memcmp(p, s, n);
+}
+
+static int line_contains(const char *p, const char *end, const char *s) {
+    size_t n = strlen(s);
+    for (; (size_t)(end - p) >= n; ++p) {
+        if (*p == *s && !memcmp(p, s, n))
+            return 1;
+    }
+    return 0;
+}
+
+static cpuid_record_t *builder_get(builder_t *b, uint32_t leaf,
+                                   uint32_t subleaf) {
+    for (uint32_t i = 0; i < b->count; ++i) {
+        if (b->records[i].leaf == leaf && b->records[i].subleaf == subleaf)
+            return &b->records[i];
+    }
+    if (b->count == b->capacity) {
+        uint32_t capacity = b->capacity ? 2 * b->capacity : 64;
+        cpuid_record_t *records = realloc(b->records,
+                                          capacity * sizeof(cpuid_record_t));
+        if (!records)
+            return NULL;
+        b->records = records;
+        b->capacity = capacity;
+    }
+    cpuid_record_t *rec = &b->records[b->count++];
+    memset(rec, 0, sizeof(*rec));
+    rec->leaf = leaf;
+    rec->subleaf = subleaf;
+    return rec;
+}
+
+/* Rows of foreign dumps come in ascending order, duplicates are appended
+ * without a lookup and resolved in builder_finish() */
+static int builder_append(builder_t *b, uint32_t leaf, uint32_t subleaf,
+                          const cpuid_result_t *r) {
+    if (b->count == b->capacity) {
+        uint32_t capacity = b->capacity ? 2 * b->capacity : 64;
+        cpuid_record_t *records = realloc(b->records,
+                                          capacity * sizeof(cpuid_record_t));
+        if (!records)
+            return -1;
+        b->records = records;
+        b->capacity = capacity;
+    }
+    cpuid_record_t *rec = &b->records[b->count++];
+    rec->leaf = leaf;
+    rec->subleaf = subleaf;
+    rec->r = *r;
+    return 0;
+}
+
+/* A row and its position in the input, which decides between duplicates */
+typedef struct {
+    cpuid_record_t rec;
+    uint32_t index;
+} ordered_record_t;
+
+static int compare_record(const void *a, const void *b) {
+    const ordered_record_t *x = a, *y = b;
+    if (x->rec.leaf != y->rec.leaf)
+        return x->rec.leaf < y->rec.leaf ? -1 : 1;
+    if (x->rec.subleaf != y->rec.subleaf)
+        return x->rec.subleaf < y->rec.subleaf ? -1 : 1;
+    // Keep the first of duplicates
+    return x->index < y->index ? -1 : x->index > y->index;
+}
+
+/* Sort rows, drop duplicates and leaves outside of the reported ranges */
+static int builder_finish(builder_t *b, cpuid_snapshot_t *snap,
+                          const char **error) {
+    ordered_record_t *sorted = malloc((b->count ? b->count : 1) * sizeof(*sorted));
+    if (!sorted) {
+        free(b->records);
+        *error = "out of memory";
+        return -1;
+    }
+    for (uint32_t i = 0; i < b->count; ++i) {
+        sorted[i].rec = b->records[i];
+        sorted[i].index = i;
+    }
+    qsort(sorted, b->count, sizeof(*sorted), compare_record);
+    for (uint32_t i = 0; i < b->count; ++i)
+        b->records[i] = sorted[i].rec;
+    free(sorted);
+
+    uint32_t max_basic = 0, max_ext = 0x80000000;
+    if (b->count && b->records[0].leaf == 0)
+        max_basic = b->records[0].r.eax;
+    for (uint32_t i = 0; i < b->count; ++i) {
+        if (b->records[i].leaf == 0x80000000) {
+            max_ext = b->records[i].r.eax;
+            break;
+        }
+    }
+
+    uint32_t n = 0;
+    for (uint32_t i = 0; i < b->count; ++i) {
+        const cpuid_record_t *rec = &b->records[i];
+        if (n && rec->leaf == b->records[n - 1].leaf
+            && rec->subleaf == b->records[n - 1].subleaf)
+            continue;
+        if (rec->leaf > max_basic
+            && (rec->leaf < 0x80000000 || rec->leaf > max_ext))
+            continue;
+        b->records[n++] = *rec;
+    }
+
+    snap->records = b->records;
+    snap->nrecords = n;
+    if (snapshot_validate(snap, error) < 0) {
+        snapshot_free(snap);
+        return -1;
+    }
+    return 0;
+}
+
+static const char *next_line(const char *line, const char *end,
+                             const char **eol) {
+    const char *e = memchr(line, '\n', end - line);
+    *eol = e ? e : end;
+    return e ? e + 1 : end;
+}
+
+/*   0x00000004 0x01: eax=0x1c004122 ebx=0x01c0003f ecx=0x0000003f edx=0x00000000 */
+static int import_cpuid_r(const char *buf, const char *end,
+                          cpuid_snapshot_t *snap, const char **error) {
+    builder_t b = {0};
+    const char *eol;
+
+    for (const char *line = buf, *next; line < end; line = next) {
+        next = next_line(line, end, &eol);
+        cursor_t c = {line, eol};
+        uint32_t leaf, subleaf;
+        cpuid_result_t r;
+
+        skip_spaces(&c);
+        if (starts_with(c.p, eol, "CPU")) {
+            if (b.count)
+                break;
+            continue;
+        }
+        if (take(&c, "0x") || take_hex8(&c, &leaf) || take(&c, " 0x")
+            || take_hex(&c, &subleaf) || take(&c, ": eax=0x")
+            || take_hex8(&c, &r.eax) || take(&c, " ebx=0x")
+            || take_hex8(&c, &r.ebx) || take(&c, " ecx=0x")
+            || take_hex8(&c, &r.ecx) || take(&c, " edx=0x")
+            || take_hex8(&c, &r.edx))
+            continue;
+        if (builder_append(&b, leaf, subleaf, &r) < 0) {
+            free(b.records);
+            *error = "out of memory";
+            return -1;
+        }
+    }
+    return builder_finish(&b, snap, error);
+}
+
+/* CPUID 00000004: 1C004122-01C0003F-0000003F-00000000 [SL 01] */
+static int import_aida64(const char *buf, const char *end,
+                         cpuid_snapshot_t *snap, const char **error) {
+    builder_t b = {0};
+    const char *eol;
+
+    for (const char *line = buf, *next; line < end; line = next) {
+        next = next_line(line, end, &eol);
+        cursor_t c = {line, eol};
+        uint32_t leaf, subleaf = 0;
+        cpuid_result_t r;
+
+        if (line_contains(line, eol, "Logical CPU #")) {
+            if (b.count)
+                break;
+            continue;
+        }
+        if (take(&c, "CPUID ") || take_hex8(&c, &leaf) || take(&c, ": ")
+            || take_hex8(&c, &r.eax) || take(&c, "-")
+            || take_hex8(&c, &r.ebx) || take(&c, "-")
+            || take_hex8(&c, &r.ecx) || take(&c, "-")
+            || take_hex8(&c, &r.edx))
+            continue;
+        skip_spaces(&c);
+        if (!take(&c, "[SL ") && take_hex(&c, &subleaf) < 0)
+            continue;
+        if (builder_append(&b, leaf, subleaf, &r) < 0) {
+            free(b.records);
+            *error = "out of memory";
+            return -1;
+        }
+    }
+    return builder_finish(&b, snap, error);
+}
+
+static uint32_t parse_dec(const char *p, const char *end) {
+    uint32_t v = 0;
+    while (p < end && *p >= '0' && *p <= '9')
+        v = v * 10 + (*p++ - '0');
+    return v;
+}
+
+/* Leaf 1 EAX for a display family and model */
+static uint32_t make_signature(uint32_t family, uint32_t model,
+                               uint32_t stepping) {
+    uint32_t eax = stepping & 0xf;
+    if (family >= 0xf) {
+        eax |= 0xf << 8;
+        eax |= ((family - 0xf) & 0xff) << 20;
+    } else {
+        eax |= (family & 0xf) << 8;
+    }
+    eax |= (model & 0xf) << 4;
+    eax |= ((model >> 4) & 0xf) << 16;
+    return eax;
+}
+
+static int import_cpuinfo(const char *buf, const char *end,
+                          cpuid_snapshot_t *snap, const char **error) {
+    builder_t b = {0};
+    const char *eol;
+    char vendor[12] = {0}, brand[48] = {0};
+    uint32_t family = 0, model = 0, stepping = 0, level = 0;
+    const char *flags = NULL, *flags_end = NULL;
+
+    for (const char *line = buf, *next; line < end; line = next) {
+        next = next_line(line, end, &eol);
+        const char *colon = memchr(line, ':', eol - line);
+        if (line == eol) {
+            // Blank line ends the first processor
+            if (flags)
+                break;
+            continue;
+        }
+        if (!colon)
+            continue;
+        const char *v = colon + 1;
+        while (v < eol && *v == ' ')
+            v++;
+        size_t vlen = eol - v;
+
+        if (starts_with(line, colon, "vendor_id"))
+            memcpy(vendor, v, vlen < 12 ? vlen : 12);
+        else if (starts_with(line, colon, "cpu family"))
+            family = parse_dec(v, eol);
+        else if (starts_with(line, colon, "model name"))
+            memcpy(brand, v, vlen < 47 ? vlen : 47);
+        else if (starts_with(line, colon, "model\t"))
+            model = parse_dec(v, eol);
+        else if (starts_with(line, colon, "stepping"))
+            stepping = parse_dec(v, eol);
+        else if (starts_with(line, colon, "cpuid level"))
+            level = parse_dec(v, eol);
+        else if (starts_with(line, colon, "flags")) {
+            flags = v;
+            flags_end = eol;
+        }
+    }
+    if (!flags || !vendor[0]) {
+        *error = "no vendor or flags in cpuinfo";
+        return -1;
+    }
+
+    cpuid_record_t *rec = builder_get(&b, 1, 0);
+    if (!rec)
+        goto oom;
+    rec->r.eax = make_signature(family, model, stepping);
+
+    for (const char *p = flags; p < flags_end; ) {
+        const char *w = p;
+        while (p < flags_end && *p != ' ')
+            p++;
+        const cpu_feature_t *f = cpu_feature_by_name(w, p - w);
+        if (f) {
+            if (f->leaf > level && f->leaf < 0x80000000)
+                level = f->leaf;
+            if (!(rec = builder_get(&b, f->leaf, f->subleaf)))
+                goto oom;
+            *cpuid_reg_ptr(&rec->r, f->reg) |= 1u << f->bit;
+        }
+        while (p < flags_end && *p == ' ')
+            p++;
+    }
+
+    // Announce subleaf 1 of leaf 7 if it is used
+    for (uint32_t i = 0; i < b.count; ++i) {
+        if (b.records[i].leaf == 0x7 && b.records[i].subleaf == 1) {
+            if (!(rec = builder_get(&b, 0x7, 0)))
+                goto oom;
+            rec->r.eax = 1;
+        }
+    }
+
+    if (!(rec = builder_get(&b, 0, 0)))
+        goto oom;
+    rec->r.eax = level;
+    memcpy(&rec->r.ebx, vendor, 4);
+    memcpy(&rec->r.edx, vendor + 4, 4);
+    memcpy(&rec->r.ecx, vendor + 8, 4);
+
+    if (brand[0]) {
+        for (uint32_t i = 0; i < 3; ++i) {
+            if (!(rec = builder_get(&b, 0x80000002 + i, 0)))
+                goto oom;
+            memcpy(&rec->r, brand + 16 * i, 16);
+        }
+    }
+    if (!(rec = builder_get(&b, 0x80000000, 0)))
+        goto oom;
+    for (uint32_t i = 0; i < b.count; ++i) {
+        if (b.records[i].leaf > rec->r.eax)
+            rec->r.eax = b.records[i].leaf;
+    }
+    return builder_finish(&b, snap, error);
+
+oom:
+    free(b.records);
+    *error = "out of memory";
+    return -1;
+}
+
+typedef enum {
+    FORMAT_NATIVE,
+    FORMAT_CPUID_R,
+    FORMAT_AIDA64,
+    FORMAT_CPUINFO,
+} format_t;
+
+static format_t detect_format(const char *buf, const char *end) {
+    const char *eol;
+    int lines = 0;
+
+    for (const char *line = buf, *next; line < end && lines < 64;
+         line = next, lines++) {
+        next = next_line(line, end, &eol);
+        if (starts_with(line, eol, "CPUID ") || line_contains(line, eol, "Logical CPU #"))
+            return FORMAT_AIDA64;
+        if (line_contains(line, eol, ": eax=0x"))
+            return FORMAT_CPUID_R;
+        if (starts_with(line, eol, "processor") && memchr(line, ':', eol - line))
+            return FORMAT_CPUINFO;
+    }
+    return FORMAT_NATIVE;
+}
+
+int snapshot_import(const char *buf, size_t len, cpuid_snapshot_t *snap,
+                    const char **error) {
+    const char *end = buf + len;
+
+    snap->records = NULL;
+    snap->nrecords = 0;
+    switch (detect_format(buf, end)) {
+        case FORMAT_CPUID_R:
+            return import_cpuid_r(buf, end, snap, error);
+        case FORMAT_AIDA64:
+            return import_aida64(buf, end, snap, error);
+        case FORMAT_CPUINFO:
+            return import_cpuinfo(buf, end, snap, error);
+        case FORMAT_NATIVE:
+        default:
+            return snapshot_parse(buf, len, snap, error);
+    }
+}
@@ -0,0 +1,104 @@
+/* Collection that leaves isolated CPUs alone
+ *
+ * Copyright (c) 2014, 2024 Grigory Rechistov and Evgeny Yulyugin.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *   * Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *   * Redistributions in binary form must reproduce the above copyright
+ *     notice, this list of conditions and the following disclaimer in the
+ *     documentation and/or other materials provided with the distribution.
+ *   * The names of its contributors may be used to endorse or promote products
+ *     derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR
+ * ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/* Running CPUID on a CPU requires being scheduled there. Migrating onto an
+ * isolated CPU, like reading /dev/cpu/N/cpuid, interrupts whatever
+ * latency-critical loop owns it. The kernel publishes the isolated CPUs and
+ * the SMT siblings in sysfs, which is read without interrupting anyone,
+ * and siblings of one core report the same CPUID except for the APIC ID. */
+
+#define _GNU_SOURCE
+#include <string.h>
+#include <stdio.h>
+#include <stdint.h>
+#include <stdlib.h>
+
+#include "isolation.h"
+
+#define SYSFS_CPU "/sys/devices/system/cpu"
+
+/* Parse a CPU list such as "0-3,8,10-11" and add it to the set */
+static void read_cpu_list(const char *path, cpu_set_t *set) {
+    FILE *f = fopen(path, "r");
+    char buf[4096];
+
+    if (!f)
+        return;
+    if (!fgets(buf, sizeof(buf), f))
+        buf[0] = '\0';
+    fclose(f);
+
+    for (char *p = buf; *p && *p != '\n'; ) {
+        char *end;
+        long first = strtol(p, &end, 10), last = first;
+        if (end == p)
+            break;
+        if (*end == '-')
+            last = strtol(end + 1, &end, 10);
+        for (long cpu = first; cpu <= last && cpu < CPU_SETSIZE; ++cpu)
+            CPU_SET(cpu, set);
+        p = *end == ',' ? end + 1 : end;
+    }
+}
+
+void isolated_cpus(cpu_set_t *set) {
+    CPU_ZERO(set);
+    read_cpu_list(SYSFS_CPU "/isolated", set);
+    read_cpu_list(SYSFS_CPU "/nohz_full", set);
+}
+
+int smt_siblings(int cpu, int *siblings, int max) {
+    char path[128];
+    cpu_set_t set;
+    int n = 0;
+
+    snprintf(path, sizeof(path), SYSFS_CPU "/cpu%d/topology/thread_siblings_list",
+             cpu);
+    CPU_ZERO(&set);
+    read_cpu_list(path, &set);
+    for (int i = 0; i < CPU_SETSIZE && n < max; ++i)
+        if (CPU_ISSET(i, &set))
+            siblings[n++] = i;
+    return n;
+}
+
+void patch_apic_id(cpuid_snapshot_t *snap, uint32_t apic_id) {
+    for (uint32_t i = 0; i < snap->nrecords; ++i) {
+        cpuid_record_t *rec = &snap->records[i];
+        switch (rec->leaf) {
+            case 0x1:
+                rec->r.ebx = (rec->r.ebx & 0x00ffffff) | (apic_id & 0xff) << 24;
+                break;
+            case 0xb:
+            case 0x1f:
+                rec->r.edx = apic_id;
+                break;
+            case 0x8000001e:
+                rec->r.eax = apic_id;
+                break;
+        }
+    }
+}
@@ -0,0 +1,400 @@
+/* Saved CPUID dumps ("snapshots") of ggg-cpuid-ia32
+ *
+ * Copyright (c) 2014, 2024 Grigory Rechistov and Evgeny Yulyugin.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *   * Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *   * Redistributions in binary form must reproduce the above copyright
+ *     notice, this list of conditions and the following disclaimer in the
+ *     documentation and/or other materials provided with the distribution.
+ *   * The names of its contributors may be used to endorse or promote products
+ *     derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR
+ * ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include <string.h>
+#include <stdio.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#include "snapshot.h"
+
+/* Values of ASCII hex digits, 0xff for everything else */
+static const uint8_t hex_value[256] = {
+    [0 ... 255] = 0xff,
+    ['0'] = 0, ['1'] = 1, ['2'] = 2, ['3'] = 3, ['4'] = 4,
+    ['5'] = 5, ['6'] = 6, ['7'] = 7, ['8'] = 8, ['9'] = 9,
+    ['a'] = 10, ['b'] = 11, ['c'] = 12, ['d'] = 13, ['e'] = 14, ['f'] = 15,
+    ['A'] = 10, ['B'] = 11, ['C'] = 12, ['D'] = 13, ['E'] = 14, ['F'] = 15,
+};
+
+/* Parse one "%#10x" field: either "0" or "0x" followed by up to 8 digits.
+ * Returns a pointer past the field or NULL. */
+static const char *parse_field(const char *p, const char *end, uint32_t *val) {
+    while (p < end && *p == ' ')
+        p++;
+    if (p == end || *p != '0')
+        return NULL;
+    p++;
+    if (p < end && (*p == 'x' || *p == 'X'))
+        p++;
+
+    uint32_t v = 0;
+    int digits = 0;
+    while (p < end && hex_value[(uint8_t)*p] != 0xff) {
+        if (++digits > 8)
+            return NULL;
+        v = (v << 4) | hex_value[(uint8_t)*p];
+        p++;
+    }
+    *val = v;
+    return p;
+}
+
+uint32_t cpuid_reg(const cpuid_result_t *r, int reg) {
+    switch (reg) {
+        case REG_EAX: return r->eax;
+        case REG_EBX: return r->ebx;
+        case REG_ECX: return r->ecx;
+        default: return r->edx;
+    }
+}
+
+uint32_t *cpuid_reg_ptr(cpuid_result_t *r, int reg) {
+    switch (reg) {
+        case REG_EAX: return &r->eax;
+        case REG_EBX: return &r->ebx;
+        case REG_ECX: return &r->ecx;
+        default: return &r->edx;
+    }
+}
+
+static int record_less(const cpuid_record_t *a, const cpuid_record_t *b) {
+    return a->leaf < b->leaf || (a->leaf == b->leaf && a->subleaf < b->subleaf);
+}
+
+int snapshot_validate(const cpuid_snapshot_t *snap, const char **error) {
+    if (snap->nrecords == 0) {
+        *error = "no CPUID rows";
+        return -1;
+    }
+    if (snap->records[0].leaf != 0) {
+        *error = "leaf 0 is missing";
+        return -1;
+    }
+    for (uint32_t i = 1; i < snap->nrecords; ++i) {
+        if (!record_less(&snap->records[i - 1], &snap->records[i])) {
+            *error = "rows are not sorted by leaf and subleaf";
+            return -1;
+        }
+    }
+
+    const cpuid_record_t *ext = snapshot_find(snap, 0x80000000, 0);
+    uint32_t max_basic = snap->records[0].r.eax;
+    uint32_t max_ext = ext ? ext->r.eax : 0x80000000;
+    for (uint32_t i = 0; i < snap->nrecords; ++i) {
+        uint32_t leaf = snap->records[i].leaf;
+        if (leaf < 0x80000000 ? leaf > max_basic : leaf > max_ext) {
+            *error = "leaf beyond the reported maximum";
+            return -1;
+        }
+    }
+    return 0;
+}
+
+int snapshot_parse(const char *buf, size_t len, cpuid_snapshot_t *snap,
+                   const char **error) {
+    const char *end = buf + len;
+
+    // Every row is a line, so the line count bounds the number of records
+    size_t max_records = 1;
+    for (const char *p = buf; (p = memchr(p, '\n', end - p)) != NULL; p++)
+        max_records++;
+
+    snap->nrecords = 0;
+    snap->records = malloc(max_records * sizeof(cpuid_record_t));
+    if (!snap->records) {
+        *error = "out of memory";
+        return -1;
+    }
+
+    const char *line = buf;
+    int seen_cpu = 0;
+    while (line < end) {
+        const char *eol = memchr(line, '\n', end - line);
+        if (!eol)
+            eol = end;
+
+        const char *p = line;
+        while (p < eol && *p == ' ')
+            p++;
+
+        // Blank lines and the table header are not rows
+        if (p == eol || *p == 'L' || *p == '-') {
+            line = eol + 1;
+            continue;
+        }
+
+        // Per-CPU dumps start every table with "CPU n:", only the first
+        // CPU is read
+        if (*p == 'C') {
+            if (eol - p < 4 || memcmp(p, "CPU ", 4)) {
+                *error = "malformed row";
+                goto fail;
+            }
+            if (seen_cpu++)
+                break;
+            line = eol + 1;
+            continue;
+        }
+
+        // The tool terminates every row, a missing newline means the
+        // file was cut short
+        if (eol == end) {
+            *error = "truncated row";
+            goto fail;
+        }
+
+        uint32_t v[6];
+        for (int i = 0; i < 6; ++i) {
+            p = parse_field(p, eol, &v[i]);
+            if (!p || (p < eol && *p != ' ')) {
+                *error = "malformed row";
+                goto fail;
+            }
+        }
+        while (p < eol && *p == ' ')
+            p++;
+        if (p != eol) {
+            *error = "trailing data after row";
+            goto fail;
+        }
+
+        cpuid_record_t *rec = &snap->records[snap->nrecords++];
+        rec->leaf = v[0];
+        rec->subleaf = v[1];
+        rec->r.eax = v[2];
+        rec->r.ebx = v[3];
+        rec->r.ecx = v[4];
+        rec->r.edx = v[5];
+        line = eol + 1;
+    }
+
+    if (snapshot_validate(snap, error))
+        goto fail;
+    return 0;
+
+fail:
+    free(snap->records);
+    snap->records = NULL;
+    snap->nrecords = 0;
+    return -1;
+}
+
+void snapshot_host_from_path(const char *path, char *host) {
+    const char *base = strrchr(path, '/');
+    base = base ? base + 1 : path;
+    size_t n = strcspn(base, ".");
+    if (n >= SNAPSHOT_HOST_LEN)
+        n = SNAPSHOT_HOST_LEN - 1;
+    memcpy(host, base, n);
+    host[n] = '\0';
+}
+
+/* procfs and pipes report a size of 0 or none at all; their contents are
+ * read into anonymous pages, so that snapshot_unmap_file() releases both
+ * kinds of buffers */
+static int read_unsized(int fd, const char **buf, size_t *len,
+                        const char **error) {
+    size_t cap = 1 << 16, n = 0;
+    char *data = malloc(cap);
+    ssize_t got = 0;
+
+    while (data && (got = read(fd, data + n, cap - n)) > 0) {
+        n += got;
+        if (n == cap) {
+            char *grown = realloc(data, cap *= 2);
+            if (!grown)
+                free(data);
+            data = grown;
+        }
+    }
+    if (!data) {
+        *error = "out of memory";
+        return -1;
+    }
+    if (got < 0 || n == 0) {
+        free(data);
+        *error = "empty or unreadable file";
+        return -1;
+    }
+
+    void *map = mmap(NULL, n, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS,
+                     -1, 0);
+    if (map == MAP_FAILED) {
+        free(data);
+        *error = "out of memory";
+        return -1;
+    }
+    memcpy(map, data, n);
+    free(data);
+    mprotect(map, n, PROT_READ);
+
+    *buf = map;
+    *len = n;
+    return 0;
+}
+
+int snapshot_map_file(const char *path, const char **buf, size_t *len,
+                      const char **error) {
+    int fd = open(path, O_RDONLY);
+    if (fd < 0) {
+        *error = "cannot open file";
+        return -1;
+    }
+
+    struct stat st;
+    if (fstat(fd, &st) < 0) {
+        close(fd);
+        *error = "empty or unreadable file";
+        return -1;
+    }
+    if (!S_ISREG(st.st_mode) || st.st_size == 0) {
+        int ret = read_unsized(fd, buf, len, error);
+        close(fd);
+        return ret;
+    }
+
+    void *map = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (map == MAP_FAILED) {
+        *error = "cannot map file";
+        return -1;
+    }
+    madvise(map, st.st_size, MADV_SEQUENTIAL);
+
+    *buf = map;
+    *len = st.st_size;
+    return 0;
+}
+
+void snapshot_unmap_file(const char *buf, size_t len) {
+    munmap((void *)buf, len);
+}
+
+int snapshot_load(const char *path, cpuid_snapshot_t *snap,
+                  const char **error) {
+    const char *buf;
+    size_t len;
+
+    if (snapshot_map_file(path, &buf, &len, error) < 0)
+        return -1;
+
+    int ret = snapshot_import(buf, len, snap, error);
+    snapshot_unmap_file(buf, len);
+    if (ret == 0)
+        snapshot_host_from_path(path, snap->host);
+    return ret;
+}
+
+int snapshot_load_cpu(const char *path, int cpu, cpuid_snapshot_t *snap,
+                      const char **error) {
+    const char *buf;
+    size_t len;
+    char header[32];
+
+    if (snapshot_map_file(path, &buf, &len, error) < 0)
+        return -1;
+
+    int header_len = snprintf(header, sizeof(header), "CPU %d:", cpu);
+    const char *end = buf + len, *table = NULL;
+    for (const char *line = buf; line < end; ) {
+        const char *eol = memchr(line, '\n', end - line);
+        if (!eol)
+            eol = end;
+        if (eol - line >= header_len && !memcmp(line, header, header_len)) {
+            table = line;
+            break;
+        }
+        line = eol + 1;
+    }
+
+    int ret = -1;
+    if (table)
+        ret = snapshot_parse(table, end - table, snap, error);
+    else
+        *error = "no such CPU in the dump";
+    snapshot_unmap_file(buf, len);
+    if (ret == 0)
+        snapshot_host_from_path(path, snap->host);
+    return ret;
+}
+
+void snapshot_free(cpuid_snapshot_t *snap) {
+    free(snap->records);
+    snap->records = NULL;
+    snap->nrecords = 0;
+}
+
+const cpuid_record_t *snapshot_find(const cpuid_snapshot_t *snap,
+                                    uint32_t leaf, uint32_t subleaf) {
+    cpuid_record_t key = {leaf, subleaf, {0}};
+    uint32_t lo = 0, hi = snap->nrecords;
+
+    while (lo < hi) {
+        uint32_t mid = lo + (hi - lo) / 2;
+        if (record_less(&snap->records[mid], &key))
+            lo = mid + 1;
+        else
+            hi = mid;
+    }
+    if (lo < snap->nrecords && !record_less(&key, &snap->records[lo]))
+        return &snap->records[lo];
+    return NULL;
+}
+
+void snapshot_vendor(const cpuid_snapshot_t *snap, char *buf) {
+    const cpuid_record_t *rec = snapshot_find(snap, 0, 0);
+    uint32_t regs[3] = {0};
+
+    // The vendor string is stored in EBX, EDX, ECX order
+    if (rec) {
+        regs[0] = rec->r.ebx;
+        regs[1] = rec->r.edx;
+        regs[2] = rec->r.ecx;
+    }
+    memcpy(buf, regs, 12);
+    buf[12] = '\0';
+}
+
+void snapshot_signature(const cpuid_snapshot_t *snap, uint32_t *family,
+                        uint32_t *model, uint32_t *stepping) {
+    const cpuid_record_t *rec = snapshot_find(snap, 1, 0);
+    uint32_t eax = rec ? rec->r.eax : 0;
+
+    *stepping = eax & 0xf;
+    *family = (eax >> 8) & 0xf;
+    *model = (eax >> 4) & 0xf;
+    // Extended model applies to families 6 and 0xf, extended family
+    // only to 0xf
+    if (*family == 0x6 || *family == 0xf)
+        *model |= ((eax >> 16) & 0xf) << 4;
+    if (*family == 0xf)
+        *family += (eax >> 20) & 0xff;
+}
@@ -0,0 +1,125 @@
+/* Saved CPUID dumps ("snapshots") of ggg-cpuid-ia32
+ *
+ * Copyright (c) 2014, 2024 Grigory Rechistov and Evgeny Yulyugin.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *   * Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *   * Redistributions in binary form must reproduce the above copyright
+ *     notice, this list of conditions and the following disclaimer in the
+ *     documentation and/or other materials provided with the distribution.
+ *   * The names of its contributors may be used to endorse or promote products
+ *     derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR
+ * ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifndef GGG_SNAPSHOT_H
+#define GGG_SNAPSHOT_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+typedef struct {
+    uint32_t eax;
+    uint32_t ebx;
+    uint32_t ecx;
+    uint32_t edx;
+} cpuid_result_t;
+
+enum {
+    REG_EAX,
+    REG_EBX,
+    REG_ECX,
+    REG_EDX,
+};
+
+uint32_t cpuid_reg(const cpuid_result_t *r, int reg);
+uint32_t *cpuid_reg_ptr(cpuid_result_t *r, int reg);
+
+/* One row of the ggg-cpuid-ia32 table */
+typedef struct {
+    uint32_t leaf;
+    uint32_t subleaf;
+    cpuid_result_t r;
+} cpuid_record_t;
+
+#define SNAPSHOT_HOST_LEN 64
+
+/* All rows of one dump, sorted by (leaf, subleaf) */
+typedef struct {
+    char host[SNAPSHOT_HOST_LEN];
+    uint32_t nrecords;
+    cpuid_record_t *records;
+} cpuid_snapshot_t;
+
+/* Parse the text printed by ggg-cpuid-ia32, of a per-CPU dump the first
+ * CPU. On failure returns -1 and points *error to a static description of
+ * the problem. */
+int snapshot_parse(const char *buf, size_t len, cpuid_snapshot_t *snap,
+                   const char **error);
+
+/* Check that rows are sorted, start with leaf 0 and stay within the
+ * maximal leaves reported by leaves 0 and 0x80000000 */
+int snapshot_validate(const cpuid_snapshot_t *snap, const char **error);
+
+/* Convert a dump in any supported format into a snapshot, see import.c */
+int snapshot_import(const char *buf, size_t len, cpuid_snapshot_t *snap,
+                    const char **error);
+
+/* Map a dump file and import it. The host name is the file name without
+ * directories and extension. */
+int snapshot_load(const char *path, cpuid_snapshot_t *snap,
+                  const char **error);
+
+/* Load the table of one CPU from a dump made with ggg-cpuid-ia32 -p */
+int snapshot_load_cpu(const char *path, int cpu, cpuid_snapshot_t *snap,
+                      const char **error);
+
+/* Read-only mapping of a whole file, released with snapshot_unmap_file() */
+int snapshot_map_file(const char *path, const char **buf, size_t *len,
+                      const char **error);
+void snapshot_unmap_file(const char *buf, size_t len);
+
+/* Host name for a dump file: its name without directories and extension */
+void snapshot_host_from_path(const char *path, char *host);
+
+void snapshot_free(cpuid_snapshot_t *snap);
+
+const cpuid_record_t *snapshot_find(const cpuid_snapshot_t *snap,
+                                    uint32_t leaf, uint32_t subleaf);
+
+/* Vendor string from leaf 0, e.g. "GenuineIntel". buf must hold 13 bytes. */
+void snapshot_vendor(const cpuid_snapshot_t *snap, char *buf);
+
+/* Display family, model and stepping decoded from leaf 1 EAX */
+void snapshot_signature(const cpuid_snapshot_t *snap, uint32_t *family,
+                        uint32_t *model, uint32_t *stepping);
+
+/* Delta encoding against a reference snapshot, see delta.c.
+ * Encoding returns the number of bytes written to buf or -1 when len is too
+ * small; snapshot_delta_bound() is always enough. Decoding validates the
+ * result like snapshot_parse() and does not set the host name. */
+size_t snapshot_delta_bound(const cpuid_snapshot_t *ref,
+                            const cpuid_snapshot_t *snap);
+long snapshot_delta_encode(const cpuid_snapshot_t *ref,
+                           const cpuid_snapshot_t *snap,
+                           uint8_t *buf, size_t len);
+int snapshot_delta_decode(const cpuid_snapshot_t *ref,
+                          const uint8_t *buf, size_t len,
+                          cpuid_snapshot_t *snap, const char **error);
+
+/* FNV-1a hash of all rows, identifies the reference of a delta */
+uint64_t snapshot_hash(const cpuid_snapshot_t *snap);
+
+#endif /* GGG_SNAPSHOT_H */